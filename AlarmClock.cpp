@@ -15,7 +15,7 @@ AlarmClock::~AlarmClock() {
 
 void AlarmClock::setTimer(std::chrono::system_clock::time_point when, std::function<void()> func) {
     std::unique_lock<std::mutex> lck(m_mutex);
-    auto it = m_timers.emplace(when, func).first;
+    auto it = m_timers.emplace(when, std::move(func));
     if(it == m_timers.begin()) {
         m_cv.notify_one();
     }
@@ -32,7 +32,7 @@ private:
     
     std::mutex m_mutex;
     std::condition_variable m_cv;
-    std::map<std::chrono::system_clock::time_point, std::function<void()> > m_timers;
+    std::multimap<std::chrono::system_clock::time_point, std::function<void()> > m_timers;
     bool m_closing = false;
     std::thread m_thread;
 };
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "AlarmClock.h"
+#include "Continuations.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/** @brief A cache of asynchronously computed values, that computes each value only once, however many callers ask for it
+ * concurrently ("single-flight").
+ *
+ * get() returns the cached future for the key if there is one, whether its value has already been computed or is still
+ * being computed; otherwise, it starts the computation and caches its future. All the callers get copies of the same
+ * Future; since the cache keeps a copy too, their continuations copy the value rather than moving it out.
+ *
+ * The keys are spread over independently locked shards. Each computed value expires after a fixed time to live, using
+ * an AlarmClock. The memory used by the computed values, as estimated by a size function, is kept under a budget by
+ * evicting values with the CLOCK algorithm (an approximation of LRU, where a hit only sets a flag). Values that are still
+ * being computed are never evicted, and computations that end with an exception are not cached.
+ * */
+template<typename K, typename V, typename Hash = std::hash<K> >
+class AsyncCache {
+public:
+    using SizeFunc = std::function<size_t(K const&, V const&)>;
+
+    struct Statistics {
+        size_t hits;
+        /** get() calls that found the value still being computed, and did not start another computation */
+        size_t coalesced;
+        size_t misses;
+        size_t evictions;
+        size_t expirations;
+    };
+
+    /**
+     * @brief Creates an empty cache
+     * @param alarmClock the clock used for expiring values; it must outlive the cache
+     * @param timeToLive the time a computed value is kept
+     * @param memoryBudget the maximum total size of the cached values
+     * @param sizeFunc returns the size of a cached key and value, counted against the budget; by default, sizeof(K) + sizeof(V)
+     * @param nrShards the number of independently locked parts of the cache; the budget is divided equally among them
+     */
+    AsyncCache(AlarmClock& alarmClock, std::chrono::system_clock::duration timeToLive, size_t memoryBudget,
+            SizeFunc sizeFunc = SizeFunc(), size_t nrShards = 16)
+        :m_pState(std::make_shared<State>(alarmClock, timeToLive, memoryBudget, std::move(sizeFunc), nrShards))
+        {}
+    AsyncCache(AsyncCache const&) = delete;
+    AsyncCache(AsyncCache&&) = delete;
+    AsyncCache& operator=(AsyncCache const&) = delete;
+    AsyncCache& operator=(AsyncCache&&) = delete;
+
+    /**
+     * @brief Returns the value for the key, computing it if it is neither cached nor being computed
+     * @param compute a function starting the computation and returning a Future<V> for it, for instance, by calling launchAsync();
+     * it is called without any lock held
+     */
+    template<typename ComputeFunc>
+    Future<V> get(K const& key, ComputeFunc compute) {
+        std::shared_ptr<PromiseFuturePair<V> > pf;
+        uint64_t generation = 0;
+        Shard& shard = m_pState->shardFor(key);
+        {
+            std::unique_lock<std::mutex> lck(shard.mutex);
+            auto it = shard.entries.find(key);
+            if(it != shard.entries.end()) {
+                Entry& entry = it->second;
+                if(entry.ready) {
+                    entry.referenced = true;
+                    m_pState->nrHits.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    m_pState->nrCoalesced.fetch_add(1, std::memory_order_relaxed);
+                }
+                return entry.value;
+            }
+            m_pState->nrMisses.fetch_add(1, std::memory_order_relaxed);
+            pf = std::make_shared<PromiseFuturePair<V> >();
+            generation = shard.nextGeneration++;
+            shard.entries.emplace(key, Entry(Future<V>(pf), generation));
+        }
+
+        std::weak_ptr<State> wpState = m_pState;
+        pf->addCallback([wpState,key,generation](typename Future<V>::FutureValueType const& val) {
+            std::shared_ptr<State> pState = wpState.lock();
+            if(pState != nullptr) {
+                pState->onComputed(key, generation, val);
+            }
+        });
+        try {
+            continuations_private::forwardResult(compute(), pf);
+        } catch(...) {
+            pf->setException(std::current_exception());
+        }
+        return Future<V>(pf);
+    }
+
+    /** @brief Removes the key from the cache. A computation in progress continues, but its result is not cached.
+     * */
+    void invalidate(K const& key) {
+        Shard& shard = m_pState->shardFor(key);
+        std::unique_lock<std::mutex> lck(shard.mutex);
+        auto it = shard.entries.find(key);
+        if(it != shard.entries.end()) {
+            m_pState->erase(shard, it);
+        }
+    }
+
+    Statistics statistics() const {
+        Statistics ret;
+        ret.hits = m_pState->nrHits.load(std::memory_order_relaxed);
+        ret.coalesced = m_pState->nrCoalesced.load(std::memory_order_relaxed);
+        ret.misses = m_pState->nrMisses.load(std::memory_order_relaxed);
+        ret.evictions = m_pState->nrEvictions.load(std::memory_order_relaxed);
+        ret.expirations = m_pState->nrExpirations.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+private:
+    struct Entry;
+    using EntryMap = std::unordered_map<K, Entry, Hash>;
+    /** The computed entries, in the order the CLOCK hand visits them. Pointers to the map elements stay valid on rehashing. */
+    using ClockRing = std::list<typename EntryMap::value_type*>;
+
+    struct Entry {
+        Entry(Future<V> value_, uint64_t generation_)
+            :value(std::move(value_)),
+            generation(generation_)
+            {}
+
+        Future<V> value;
+        /** Distinguishes this entry from earlier ones with the same key, for the completion and expiration callbacks */
+        uint64_t generation;
+        /** The value has been computed and is counted in the memory budget */
+        bool ready = false;
+        bool referenced = false;
+        size_t size = 0;
+        typename ClockRing::iterator clockPos;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        EntryMap entries;
+        ClockRing clock;
+        typename ClockRing::iterator clockHand = clock.end();
+        size_t usedMemory = 0;
+        uint64_t nextGeneration = 0;
+    };
+
+    struct State : public std::enable_shared_from_this<State> {
+        State(AlarmClock& alarmClock_, std::chrono::system_clock::duration timeToLive_, size_t memoryBudget,
+                SizeFunc sizeFunc_, size_t nrShards_)
+            :alarmClock(alarmClock_),
+            timeToLive(timeToLive_),
+            sizeFunc(std::move(sizeFunc_)),
+            nrShards(nrShards_ == 0 ? 1 : nrShards_),
+            shardBudget(memoryBudget / nrShards),
+            shards(new Shard[nrShards])
+        {
+            if(!sizeFunc) {
+                sizeFunc = [](K const&, V const&){return sizeof(K) + sizeof(V);};
+            }
+        }
+
+        Shard& shardFor(K const& key) {
+            return shards[hash(key) % nrShards];
+        }
+
+        /** @brief Caches a computed value, or drops the entry of a failed computation.
+         * */
+        void onComputed(K const& key, uint64_t generation, typename Future<V>::FutureValueType const& val) {
+            Shard& shard = shardFor(key);
+            std::unique_lock<std::mutex> lck(shard.mutex);
+            auto it = shard.entries.find(key);
+            if(it == shard.entries.end() || it->second.generation != generation) {
+                return;
+            }
+            if(!std::holds_alternative<V>(val)) {
+                shard.entries.erase(it);
+                return;
+            }
+            Entry& entry = it->second;
+            entry.ready = true;
+            entry.size = sizeFunc(key, std::get<V>(val));
+            entry.clockPos = shard.clock.insert(shard.clockHand, &*it);
+            shard.usedMemory += entry.size;
+
+            std::weak_ptr<State> wpState = this->shared_from_this();
+            alarmClock.setTimer(std::chrono::system_clock::now() + timeToLive, [wpState,key,generation]() {
+                std::shared_ptr<State> pState = wpState.lock();
+                if(pState != nullptr) {
+                    pState->expire(key, generation);
+                }
+            });
+            evict(shard);
+        }
+
+        void expire(K const& key, uint64_t generation) {
+            Shard& shard = shardFor(key);
+            std::unique_lock<std::mutex> lck(shard.mutex);
+            auto it = shard.entries.find(key);
+            if(it != shard.entries.end() && it->second.generation == generation) {
+                erase(shard, it);
+                nrExpirations.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        /** @brief Runs the CLOCK hand until the shard is within its budget. Called with the shard locked.
+         * */
+        void evict(Shard& shard) {
+            // Only the computed entries use memory, and they are all on the ring, so this ends within two turns
+            while(shard.usedMemory > shardBudget) {
+                if(shard.clockHand == shard.clock.end()) {
+                    shard.clockHand = shard.clock.begin();
+                }
+                Entry& entry = (*shard.clockHand)->second;
+                if(entry.referenced) {
+                    entry.referenced = false;
+                    ++shard.clockHand;
+                } else {
+                    erase(shard, shard.entries.find((*shard.clockHand)->first));
+                    nrEvictions.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /** @brief Removes an entry. Called with the shard locked.
+         * */
+        void erase(Shard& shard, typename EntryMap::iterator it) {
+            Entry& entry = it->second;
+            if(entry.ready) {
+                if(shard.clockHand == entry.clockPos) {
+                    ++shard.clockHand;
+                }
+                shard.clock.erase(entry.clockPos);
+                shard.usedMemory -= entry.size;
+            }
+            shard.entries.erase(it);
+        }
+
+        AlarmClock& alarmClock;
+        std::chrono::system_clock::duration const timeToLive;
+        SizeFunc sizeFunc;
+        Hash hash;
+        size_t const nrShards;
+        size_t const shardBudget;
+        std::unique_ptr<Shard[]> shards;
+
+        std::atomic<size_t> nrHits{0};
+        std::atomic<size_t> nrCoalesced{0};
+        std::atomic<size_t> nrMisses{0};
+        std::atomic<size_t> nrEvictions{0};
+        std::atomic<size_t> nrExpirations{0};
+    };
+
+    std::shared_ptr<State> m_pState;
+};
@@ -0,0 +1,100 @@
+#include "AsyncFile.h"
+
+#include "BlockingExecutor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<AsyncFile> openAsyncFile(Executor& ioExecutor, char const* path, int flags, mode_t mode) {
+    int fd = ::open(path, flags | O_CLOEXEC, mode);
+    if(fd < 0) {
+        perror("open()");
+        return nullptr;
+    }
+    return std::unique_ptr<AsyncFile>(new AsyncFile(ioExecutor, fd));
+}
+
+std::unique_ptr<AsyncFile> openAsyncFile(char const* path, int flags, mode_t mode) {
+    return openAsyncFile(blockingExecutor(), path, flags, mode);
+}
+
+AsyncFile::AsyncFile(Executor& ioExecutor, int fd)
+    :m_ioExecutor(ioExecutor),
+    m_fd(fd)
+{
+    // empty
+}
+
+AsyncFile::~AsyncFile() {
+    ::close(m_fd);
+}
+
+Future<ssize_t> AsyncFile::pread(void* data, size_t len, off_t offset) {
+    std::shared_ptr<PromiseFuturePair<ssize_t> > pf = std::make_shared<PromiseFuturePair<ssize_t> >();
+    m_ioExecutor.enqueue([this,pf,data,len,offset](){
+        ssize_t ret;
+        do {
+            ret = ::pread(m_fd, data, len, offset);
+        } while(ret < 0 && errno == EINTR);
+        if(ret < 0) {
+            perror("pread()");
+        }
+        pf->set(ret);
+    });
+    return Future<ssize_t>(pf);
+}
+
+Future<ssize_t> AsyncFile::pwrite(void const* data, size_t len, off_t offset) {
+    std::shared_ptr<PromiseFuturePair<ssize_t> > pf = std::make_shared<PromiseFuturePair<ssize_t> >();
+    m_ioExecutor.enqueue([this,pf,data,len,offset](){
+        size_t written = 0;
+        while(written < len) {
+            ssize_t ret = ::pwrite(m_fd, static_cast<char const*>(data) + written, len - written, offset + off_t(written));
+            if(ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if(ret <= 0) {
+                // Writing nothing is not an error for pwrite(2), but retrying would not make progress
+                if(ret == 0) {
+                    fprintf(stderr, "pwrite(): no byte written\n");
+                } else {
+                    perror("pwrite()");
+                }
+                pf->set(-1);
+                return;
+            }
+            written += size_t(ret);
+        }
+        pf->set(ssize_t(written));
+    });
+    return Future<ssize_t>(pf);
+}
+
+Future<bool> AsyncFile::fsync() {
+    std::shared_ptr<PromiseFuturePair<bool> > pf = std::make_shared<PromiseFuturePair<bool> >();
+    m_ioExecutor.enqueue([this,pf](){
+        int ret;
+        do {
+            ret = ::fsync(m_fd);
+        } while(ret < 0 && errno == EINTR);
+        if(ret < 0) {
+            perror("fsync()");
+            pf->set(false);
+            return;
+        }
+        pf->set(true);
+    });
+    return Future<bool>(pf);
+}
+
+off_t AsyncFile::size() const {
+    struct stat st;
+    if(0 > ::fstat(m_fd, &st)) {
+        perror("fstat()");
+        return -1;
+    }
+    return st.st_size;
+}
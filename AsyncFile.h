@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Executor.h"
+#include "Future.h"
+
+#include <memory>
+#include <sys/types.h>
+
+class AsyncFile;
+
+/** @brief Opens a file, with the same flags and mode as open(2). Returns nullptr on failure.
+ * @param ioExecutor The executor where the blocking file operations are to be executed. It should be dedicated
+ * to I/O, so that the blocking operations do not stall the continuations running on the compute executors.
+ * */
+std::unique_ptr<AsyncFile> openAsyncFile(Executor& ioExecutor, char const* path, int flags, mode_t mode = 0644);
+
+/** @brief Opens a file whose blocking operations are executed on the process-wide blockingExecutor().
+ * */
+std::unique_ptr<AsyncFile> openAsyncFile(char const* path, int flags, mode_t mode = 0644);
+
+/** @brief A file offering asynchronous operations.
+ *
+ * Each operation executes as a blocking call on the I/O executor. The AsyncFile object, as well as the buffers given
+ * to pread() and pwrite(), must stay valid until the operations complete.
+ * */
+class AsyncFile {
+public:
+    AsyncFile(AsyncFile const&) = delete;
+    AsyncFile(AsyncFile&&) = delete;
+    AsyncFile& operator=(AsyncFile const&) = delete;
+    AsyncFile& operator=(AsyncFile&&) = delete;
+    ~AsyncFile();
+
+    /**
+     * @brief Launches reading from the file, at the given offset
+     * @return a future that will receive the number of bytes actually read, 0 at end of file, or a negative number on error
+     */
+    Future<ssize_t> pread(void* data, size_t len, off_t offset);
+
+    /**
+     * @brief Launches writing to the file, at the given offset
+     * @return a future that will receive the number of bytes written (len, unless an error occurs), or a negative number on error
+     */
+    Future<ssize_t> pwrite(void const* data, size_t len, off_t offset);
+
+    /** @brief Launches flushing the file to the disk. The future will be set to true on success or on false on failure
+     * */
+    Future<bool> fsync();
+
+    /** @brief Returns the current size of the file, or -1 on error
+     * */
+    off_t size() const;
+
+    /** @brief Returns the file descriptor, for instance, to be given to Socket::sendFile()
+     * */
+    int fd() const {
+        return m_fd;
+    }
+
+private:
+    friend std::unique_ptr<AsyncFile> openAsyncFile(Executor& ioExecutor, char const* path, int flags, mode_t mode);
+
+    AsyncFile(Executor& ioExecutor, int fd);
+
+    Executor& m_ioExecutor;
+    int m_fd;
+};
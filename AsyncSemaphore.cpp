@@ -0,0 +1,68 @@
+#include "AsyncSemaphore.h"
+
+/** @brief A queued acquire: the shared state of its future, plus the link to the next waiter.
+ * */
+class AsyncSemaphore::Waiter : public PromiseFuturePair<AsyncSemaphore::Guard> {
+public:
+    std::shared_ptr<Waiter> m_pNext;
+};
+
+AsyncSemaphore::AsyncSemaphore(Executor& executor, size_t nrPermits)
+    :m_executor(executor),
+    m_nrAvailable(ptrdiff_t(nrPermits))
+{
+}
+
+AsyncSemaphore::~AsyncSemaphore() = default;
+
+Future<AsyncSemaphore::Guard> AsyncSemaphore::acquire() {
+    if(m_nrAvailable.fetch_sub(1, std::memory_order_acq_rel) > 0) {
+        return completedFuture(Guard(this));
+    }
+    // No permit; the next release() will hand one over to us
+    std::unique_lock<std::mutex> lck(m_mutex);
+    if(m_nrPendingHandoffs > 0) {
+        --m_nrPendingHandoffs;
+        lck.unlock();
+        return completedFuture(Guard(this));
+    }
+    std::shared_ptr<Waiter> pWaiter = std::make_shared<Waiter>();
+    if(m_pLastWaiter == nullptr) {
+        m_pFirstWaiter = pWaiter;
+    } else {
+        m_pLastWaiter->m_pNext = pWaiter;
+    }
+    m_pLastWaiter = pWaiter.get();
+    return Future<Guard>(std::move(pWaiter));
+}
+
+std::optional<AsyncSemaphore::Guard> AsyncSemaphore::tryAcquire() {
+    ptrdiff_t nrAvailable = m_nrAvailable.load(std::memory_order_relaxed);
+    while(nrAvailable > 0) {
+        if(m_nrAvailable.compare_exchange_weak(nrAvailable, nrAvailable - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            return Guard(this);
+        }
+    }
+    return std::nullopt;
+}
+
+void AsyncSemaphore::release() {
+    if(m_nrAvailable.fetch_add(1, std::memory_order_acq_rel) >= 0) {
+        return;
+    }
+    // Some acquirer is waiting, or about to
+    std::unique_lock<std::mutex> lck(m_mutex);
+    if(m_pFirstWaiter == nullptr) {
+        ++m_nrPendingHandoffs;
+        return;
+    }
+    std::shared_ptr<Waiter> pWaiter = std::move(m_pFirstWaiter);
+    m_pFirstWaiter = std::move(pWaiter->m_pNext);
+    if(m_pFirstWaiter == nullptr) {
+        m_pLastWaiter = nullptr;
+    }
+    lck.unlock();
+    m_executor.enqueue([this,pWaiter](){
+        pWaiter->set(Guard(this));
+    });
+}
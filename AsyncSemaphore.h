@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Executor.h"
+#include "Future.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+/** @brief A counting semaphore whose waiters are continuations, not threads.
+ *
+ * acquire() returns a future of a Guard, which holds one permit until it is destroyed (or released). When no permit is
+ * available, the caller is queued and its future completes, on the executor, when a permit is handed over to it; the
+ * queued callers are served in FIFO order. No thread is blocked while waiting.
+ *
+ * The available permits are kept in an atomic counter that goes negative when there are waiters, so acquiring and releasing
+ * take no lock as long as there is no contention. The mutex is only taken to queue a waiter or hand a permit over to one.
+ *
+ * The semaphore must outlive all its guards and pending acquires.
+ * */
+class AsyncSemaphore {
+public:
+    /** @brief Holds one permit of a semaphore. Move-only; releases the permit when destroyed.
+     * */
+    class Guard {
+    public:
+        Guard() = default;
+        Guard(Guard const&) = delete;
+        Guard(Guard&& other) noexcept
+            :m_pSemaphore(other.m_pSemaphore)
+        {
+            other.m_pSemaphore = nullptr;
+        }
+        Guard& operator=(Guard const&) = delete;
+        Guard& operator=(Guard&& other) noexcept {
+            if(this != &other) {
+                release();
+                m_pSemaphore = other.m_pSemaphore;
+                other.m_pSemaphore = nullptr;
+            }
+            return *this;
+        }
+        ~Guard() {
+            release();
+        }
+
+        /** @brief Returns true if this guard holds a permit.
+         * */
+        bool ownsPermit() const {
+            return m_pSemaphore != nullptr;
+        }
+
+        /** @brief Releases the permit before the guard is destroyed.
+         * */
+        void release() {
+            if(m_pSemaphore != nullptr) {
+                m_pSemaphore->release();
+                m_pSemaphore = nullptr;
+            }
+        }
+
+    private:
+        friend class AsyncSemaphore;
+
+        explicit Guard(AsyncSemaphore* pSemaphore)
+            :m_pSemaphore(pSemaphore)
+            {}
+
+        AsyncSemaphore* m_pSemaphore = nullptr;
+    };
+
+    /**
+     * @brief Creates a semaphore
+     * @param executor the executor where the waiters are resumed
+     * @param nrPermits the number of permits initially available
+     */
+    AsyncSemaphore(Executor& executor, size_t nrPermits);
+    AsyncSemaphore(AsyncSemaphore const&) = delete;
+    AsyncSemaphore(AsyncSemaphore&&) = delete;
+    AsyncSemaphore& operator=(AsyncSemaphore const&) = delete;
+    AsyncSemaphore& operator=(AsyncSemaphore&&) = delete;
+    ~AsyncSemaphore();
+
+    /** @brief Takes a permit. The returned future is already completed if a permit is available.
+     * */
+    Future<Guard> acquire();
+
+    /** @brief Takes a permit if one is available right now; never waits.
+     * */
+    std::optional<Guard> tryAcquire();
+
+    /** @brief Returns the number of available permits; negative values count the waiters. For statistics only.
+     * */
+    ptrdiff_t availablePermits() const {
+        return m_nrAvailable.load(std::memory_order_relaxed);
+    }
+
+private:
+    class Waiter;
+
+    void release();
+
+    Executor& m_executor;
+    std::atomic<ptrdiff_t> m_nrAvailable;
+
+    std::mutex m_mutex;
+    /** Intrusive FIFO list of waiters; each one owns the next. */
+    std::shared_ptr<Waiter> m_pFirstWaiter;
+    Waiter* m_pLastWaiter = nullptr;
+    /** Permits released for acquirers that have decremented the counter but not queued themselves yet. */
+    size_t m_nrPendingHandoffs = 0;
+};
+
+/** @brief A mutex whose waiters are continuations, not threads; an AsyncSemaphore with a single permit.
+ * */
+class AsyncMutex {
+public:
+    using Guard = AsyncSemaphore::Guard;
+
+    explicit AsyncMutex(Executor& executor)
+        :m_semaphore(executor, 1)
+        {}
+
+    /** @brief Locks the mutex; it is unlocked when the Guard is destroyed. The future is already completed if the mutex is free.
+     * */
+    Future<Guard> acquire() {
+        return m_semaphore.acquire();
+    }
+
+    std::optional<Guard> tryAcquire() {
+        return m_semaphore.tryAcquire();
+    }
+
+private:
+    AsyncSemaphore m_semaphore;
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "Future.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/** @brief An asynchronous sequence of values, passed from a producer to a consumer through a bounded buffer.
+ *
+ * The consumer pulls the values with next() or, paying for a single future per group of values, with nextBatch(). The
+ * producer appends values with push() or pushBatch(); the returned future completes only when the buffer has room again,
+ * and the producer must wait for it before pushing more. Thus, a slow consumer slows down the producer, instead of letting
+ * the buffer grow. The producer ends the sequence with close() or fail(); the consumer may give up with cancel().
+ *
+ * AsyncStream objects are handles; copies refer to the same sequence. There must be a single producer and a single consumer,
+ * and the consumer must wait for each next() or nextBatch() to complete before calling them again.
+ * */
+template<typename T>
+class AsyncStream {
+public:
+    /** @brief Creates an empty stream; the producer is held back while at least capacity values are buffered.
+     * */
+    explicit AsyncStream(size_t capacity = 64)
+        :m_pState(std::make_shared<State>(capacity))
+        {}
+
+    /**
+     * @brief Takes the next value from the stream
+     * @return a future that will receive the value, or std::nullopt at the end of the stream, or the exception given to fail()
+     */
+    Future<std::optional<T> > next() {
+        std::unique_lock<std::mutex> lck(m_pState->mutex);
+        if(!m_pState->buffer.empty()) {
+            std::optional<T> ret(std::move(m_pState->buffer.front()));
+            m_pState->buffer.pop_front();
+            std::shared_ptr<PromiseFuturePair<bool> > pProducer = takeProducerIfRoom();
+            lck.unlock();
+            if(pProducer != nullptr) {
+                pProducer->set(true);
+            }
+            return completedFuture(std::move(ret));
+        }
+        if(m_pState->pException != nullptr) {
+            return failedFuture<std::optional<T> >(m_pState->pException);
+        }
+        if(m_pState->closed) {
+            return completedFuture(std::optional<T>());
+        }
+        m_pState->pNextWaiter = std::make_shared<PromiseFuturePair<std::optional<T> > >();
+        return Future<std::optional<T> >(m_pState->pNextWaiter);
+    }
+
+    /**
+     * @brief Takes the next values from the stream, as soon as there is at least one
+     * @param maxCount the maximum number of values to take
+     * @return a future that will receive between 1 and maxCount values, or no value at the end of the stream, or
+     * the exception given to fail()
+     */
+    Future<std::vector<T> > nextBatch(size_t maxCount) {
+        std::unique_lock<std::mutex> lck(m_pState->mutex);
+        if(!m_pState->buffer.empty()) {
+            std::vector<T> ret = takeBatch(maxCount);
+            std::shared_ptr<PromiseFuturePair<bool> > pProducer = takeProducerIfRoom();
+            lck.unlock();
+            if(pProducer != nullptr) {
+                pProducer->set(true);
+            }
+            return completedFuture(std::move(ret));
+        }
+        if(m_pState->pException != nullptr) {
+            return failedFuture<std::vector<T> >(m_pState->pException);
+        }
+        if(m_pState->closed) {
+            return completedFuture(std::vector<T>());
+        }
+        m_pState->pBatchWaiter = std::make_shared<PromiseFuturePair<std::vector<T> > >();
+        m_pState->batchMaxCount = maxCount;
+        return Future<std::vector<T> >(m_pState->pBatchWaiter);
+    }
+
+    /**
+     * @brief Appends a value to the stream
+     * @return a future that will be set to true when the producer may push again, or to false if the consumer has
+     * cancelled the stream or the stream is already closed; the value is then discarded
+     */
+    Future<bool> push(T value) {
+        std::unique_lock<std::mutex> lck(m_pState->mutex);
+        if(m_pState->cancelled || m_pState->closed) {
+            return completedFuture(false);
+        }
+        m_pState->buffer.push_back(std::move(value));
+        return afterPush(lck);
+    }
+
+    /** @brief Appends all the values to the stream; the same as calling push() for each of them, but waiting only once.
+     * */
+    Future<bool> pushBatch(std::vector<T> values) {
+        std::unique_lock<std::mutex> lck(m_pState->mutex);
+        if(m_pState->cancelled || m_pState->closed) {
+            return completedFuture(false);
+        }
+        for(T& value : values) {
+            m_pState->buffer.push_back(std::move(value));
+        }
+        return afterPush(lck);
+    }
+
+    /** @brief Ends the stream; the consumer gets the values already pushed, and then the end of the stream.
+     * */
+    void close() {
+        finish(nullptr);
+    }
+
+    /** @brief Ends the stream with an error; the consumer gets the values already pushed, and then the exception.
+     * */
+    void fail(std::exception_ptr pEx) {
+        finish(std::move(pEx));
+    }
+
+    /** @brief Called by the consumer to discard the buffered values and make all further pushes return false.
+     * */
+    void cancel() {
+        std::unique_lock<std::mutex> lck(m_pState->mutex);
+        m_pState->cancelled = true;
+        m_pState->buffer.clear();
+        std::shared_ptr<PromiseFuturePair<bool> > pProducer = std::move(m_pState->pProducer);
+        lck.unlock();
+        if(pProducer != nullptr) {
+            pProducer->set(false);
+        }
+    }
+
+private:
+    struct State {
+        explicit State(size_t cap)
+            :capacity(cap == 0 ? 1 : cap)
+            {}
+
+        size_t const capacity;
+        std::mutex mutex;
+        std::deque<T> buffer;
+        bool closed = false;
+        bool cancelled = false;
+        std::exception_ptr pException;
+        std::shared_ptr<PromiseFuturePair<std::optional<T> > > pNextWaiter;
+        std::shared_ptr<PromiseFuturePair<std::vector<T> > > pBatchWaiter;
+        size_t batchMaxCount = 0;
+        std::shared_ptr<PromiseFuturePair<bool> > pProducer;
+    };
+
+    // All the following are called with the mutex locked
+
+    std::vector<T> takeBatch(size_t maxCount) {
+        size_t count = std::min(maxCount == 0 ? 1 : maxCount, m_pState->buffer.size());
+        std::vector<T> ret;
+        ret.reserve(count);
+        for(size_t i = 0 ; i < count ; ++i) {
+            ret.push_back(std::move(m_pState->buffer.front()));
+            m_pState->buffer.pop_front();
+        }
+        return ret;
+    }
+
+    std::shared_ptr<PromiseFuturePair<bool> > takeProducerIfRoom() {
+        if(m_pState->buffer.size() < m_pState->capacity) {
+            return std::move(m_pState->pProducer);
+        }
+        return nullptr;
+    }
+
+    /** @brief Hands values over to a waiting consumer, if any, then decides whether the producer must wait. Unlocks lck.
+     * */
+    Future<bool> afterPush(std::unique_lock<std::mutex>& lck) {
+        std::shared_ptr<PromiseFuturePair<std::optional<T> > > pNextWaiter;
+        std::shared_ptr<PromiseFuturePair<std::vector<T> > > pBatchWaiter;
+        // After an empty pushBatch(), the consumer keeps waiting; an empty batch would read as the end of the stream
+        if(!m_pState->buffer.empty()) {
+            pNextWaiter = std::move(m_pState->pNextWaiter);
+            pBatchWaiter = std::move(m_pState->pBatchWaiter);
+        }
+        std::optional<T> nextValue;
+        std::vector<T> batchValues;
+        if(pNextWaiter != nullptr) {
+            nextValue.emplace(std::move(m_pState->buffer.front()));
+            m_pState->buffer.pop_front();
+        } else if(pBatchWaiter != nullptr) {
+            batchValues = takeBatch(m_pState->batchMaxCount);
+        }
+        Future<bool> ret = completedFuture(true);
+        if(m_pState->buffer.size() >= m_pState->capacity) {
+            m_pState->pProducer = std::make_shared<PromiseFuturePair<bool> >();
+            ret = Future<bool>(m_pState->pProducer);
+        }
+        lck.unlock();
+        if(pNextWaiter != nullptr) {
+            pNextWaiter->set(std::move(nextValue));
+        } else if(pBatchWaiter != nullptr) {
+            pBatchWaiter->set(std::move(batchValues));
+        }
+        return ret;
+    }
+
+    void finish(std::exception_ptr pEx) {
+        std::unique_lock<std::mutex> lck(m_pState->mutex);
+        m_pState->closed = true;
+        m_pState->pException = pEx;
+        // A consumer waits only when the buffer is empty
+        std::shared_ptr<PromiseFuturePair<std::optional<T> > > pNextWaiter = std::move(m_pState->pNextWaiter);
+        std::shared_ptr<PromiseFuturePair<std::vector<T> > > pBatchWaiter = std::move(m_pState->pBatchWaiter);
+        lck.unlock();
+        if(pNextWaiter != nullptr) {
+            if(pEx != nullptr) {
+                pNextWaiter->setException(pEx);
+            } else {
+                pNextWaiter->set(std::nullopt);
+            }
+        }
+        if(pBatchWaiter != nullptr) {
+            if(pEx != nullptr) {
+                pBatchWaiter->setException(pEx);
+            } else {
+                pBatchWaiter->set(std::vector<T>());
+            }
+        }
+    }
+
+    std::shared_ptr<State> m_pState;
+};
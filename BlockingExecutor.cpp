@@ -0,0 +1,13 @@
+#include "BlockingExecutor.h"
+
+#include "ThreadPool.h"
+
+namespace {
+    size_t const maxBlockingThreads = 512;
+}
+
+Executor& blockingExecutor() {
+    static ThreadPool executor(0, maxBlockingThreads, std::chrono::steady_clock::duration::zero(), std::chrono::seconds(10),
+        false);
+    return executor;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Executor.h"
+
+/** @brief Returns the process-wide executor for blocking calls (DNS resolution, disk I/O, third-party blocking APIs).
+ *
+ * It is an elastic ThreadPool that starts a new thread whenever a call is enqueued while all its threads are busy, up to
+ * a high limit, and lets threads retire after they stay idle. It does not use worker slots, so a blocking call enqueued
+ * from a blocking call also gets a thread of its own. Thus, below the limit, blocking calls never wait behind each other
+ * and never occupy the threads of the compute executors, which can then be sized to the number of cores.
+ * */
+Executor& blockingExecutor();
@@ -0,0 +1,162 @@
+#include "BufferPool.h"
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <stdio.h>
+#include <sys/mman.h>
+
+using buffer_pool_private::Slab;
+
+BufferSlice::BufferSlice(Slab* pSlab, char* data, size_t size)
+    :m_pSlab(pSlab),
+    m_data(data),
+    m_size(size)
+{
+    if(m_pSlab != nullptr) {
+        m_pSlab->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+BufferSlice::BufferSlice(BufferSlice const& other)
+    :BufferSlice(other.m_pSlab, other.m_data, other.m_size)
+{
+}
+
+BufferSlice::BufferSlice(BufferSlice&& other) noexcept
+    :m_pSlab(other.m_pSlab),
+    m_data(other.m_data),
+    m_size(other.m_size)
+{
+    other.m_pSlab = nullptr;
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+BufferSlice& BufferSlice::operator=(BufferSlice const& other) {
+    BufferSlice tmp(other);
+    *this = std::move(tmp);
+    return *this;
+}
+
+BufferSlice& BufferSlice::operator=(BufferSlice&& other) noexcept {
+    std::swap(m_pSlab, other.m_pSlab);
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    return *this;
+}
+
+BufferSlice::~BufferSlice() {
+    reset();
+}
+
+BufferSlice BufferSlice::subSlice(size_t offset, size_t len) const {
+    return BufferSlice(m_pSlab, m_data + offset, len);
+}
+
+void BufferSlice::reset() {
+    if(m_pSlab != nullptr && m_pSlab->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_pSlab->pPool->release(m_pSlab);
+    }
+    m_pSlab = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+}
+
+namespace {
+    size_t roundUpToPowerOf2(size_t v) {
+        size_t ret = 1;
+        while(ret < v) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+}
+
+BufferPool::BufferPool(size_t slabSize, size_t slabsPerChunk, bool useHugePages)
+    :m_slabSize(roundUpToPowerOf2(slabSize)),
+    m_slabsPerChunk(slabsPerChunk == 0 ? 1 : slabsPerChunk),
+    m_useHugePages(useHugePages)
+{
+}
+
+BufferPool::~BufferPool() {
+    for(auto const& chunk : m_chunks) {
+        ::munmap(chunk.first, chunk.second);
+    }
+}
+
+BufferSlice BufferPool::allocate() {
+    std::unique_lock<std::mutex> lck(m_mutex);
+    if(m_freeSlabs.empty()) {
+        allocateChunk();
+    }
+    Slab* pSlab = m_freeSlabs.back();
+    m_freeSlabs.pop_back();
+    lck.unlock();
+    return BufferSlice(pSlab, pSlab->data, m_slabSize);
+}
+
+BufferSlice BufferPool::allocateSmall(size_t size) {
+    assert(size <= m_slabSize);
+    // Keeps the slices aligned, as if each had been allocated on its own
+    size_t reserved = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    std::unique_lock<std::mutex> lck(m_mutex);
+    if(m_pSmallSlab == nullptr || m_slabSize - m_smallPos < reserved) {
+        if(m_pSmallSlab != nullptr && m_pSmallSlab->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_freeSlabs.push_back(m_pSmallSlab);
+        }
+        if(m_freeSlabs.empty()) {
+            allocateChunk();
+        }
+        m_pSmallSlab = m_freeSlabs.back();
+        m_freeSlabs.pop_back();
+        m_pSmallSlab->refCount.fetch_add(1, std::memory_order_relaxed);
+        m_smallPos = 0;
+    }
+    // The slice takes its reference while the lock is held, before the pool may drop its own
+    BufferSlice ret(m_pSmallSlab, m_pSmallSlab->data + m_smallPos, size);
+    m_smallPos += reserved;
+    return ret;
+}
+
+size_t BufferPool::nrSlabsInUse() const {
+    std::unique_lock<std::mutex> lck(m_mutex);
+    return m_nrSlabs - m_freeSlabs.size();
+}
+
+void BufferPool::release(Slab* pSlab) {
+    std::unique_lock<std::mutex> lck(m_mutex);
+    m_freeSlabs.push_back(pSlab);
+}
+
+void BufferPool::allocateChunk() {
+    size_t chunkSize = m_slabSize * m_slabsPerChunk;
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if(m_useHugePages) {
+        p = ::mmap(nullptr, chunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if(p == MAP_FAILED) {
+        p = ::mmap(nullptr, chunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED) {
+            perror("mmap()");
+            throw std::bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        if(m_useHugePages) {
+            ::madvise(p, chunkSize, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    m_chunks.emplace_back(p, chunkSize);
+    std::unique_ptr<Slab[]> slabs(new Slab[m_slabsPerChunk]);
+    for(size_t i = 0 ; i < m_slabsPerChunk ; ++i) {
+        slabs[i].pPool = this;
+        slabs[i].data = static_cast<char*>(p) + i * m_slabSize;
+        m_freeSlabs.push_back(&slabs[i]);
+    }
+    m_slabs.push_back(std::move(slabs));
+    m_nrSlabs += m_slabsPerChunk;
+}
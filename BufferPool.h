@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class BufferPool;
+
+namespace buffer_pool_private {
+    /** @brief Bookkeeping data for one slab; kept apart from the slab memory.
+     * */
+    struct Slab {
+        std::atomic<size_t> refCount{0};
+        BufferPool* pPool = nullptr;
+        char* data = nullptr;
+    };
+}
+
+/** @brief A reference to a range of bytes within a slab of a BufferPool.
+ *
+ * Copying a BufferSlice only increments the reference count of the slab; the slab returns to its pool when the last
+ * slice referring to it is destroyed. Thus, a slice can be handed over to an asynchronous operation (for instance,
+ * Socket::send()) without copying the data. The slices must not outlive their pool.
+ * */
+class BufferSlice {
+public:
+    BufferSlice() = default;
+    BufferSlice(BufferSlice const& other);
+    BufferSlice(BufferSlice&& other) noexcept;
+    BufferSlice& operator=(BufferSlice const& other);
+    BufferSlice& operator=(BufferSlice&& other) noexcept;
+    ~BufferSlice();
+
+    char* data() const {
+        return m_data;
+    }
+    size_t size() const {
+        return m_size;
+    }
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    /** @brief Returns a slice referring to len bytes starting at offset, within this slice.
+     * */
+    BufferSlice subSlice(size_t offset, size_t len) const;
+
+    /** @brief Releases the reference to the slab, leaving this slice empty.
+     * */
+    void reset();
+
+private:
+    friend class BufferPool;
+
+    BufferSlice(buffer_pool_private::Slab* pSlab, char* data, size_t size);
+
+    buffer_pool_private::Slab* m_pSlab = nullptr;
+    char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+/** @brief Pool of fixed-size memory slabs.
+ *
+ * Slabs are carved out of large chunks obtained with mmap(), optionally backed by huge pages, and are recycled
+ * instead of being returned to the system. The chunks are freed when the pool is destroyed.
+ * */
+class BufferPool {
+public:
+    /**
+     * @brief Creates an empty pool
+     * @param slabSize the size of each slab; it is rounded up to a power of 2
+     * @param slabsPerChunk the number of slabs obtained from the system at once
+     * @param useHugePages if true, chunks are allocated in huge pages, if the system has any available
+     */
+    explicit BufferPool(size_t slabSize = 16384, size_t slabsPerChunk = 64, bool useHugePages = false);
+    BufferPool(BufferPool const&) = delete;
+    BufferPool(BufferPool&&) = delete;
+    BufferPool& operator=(BufferPool const&) = delete;
+    BufferPool& operator=(BufferPool&&) = delete;
+    ~BufferPool();
+
+    /** @brief Returns a slice covering a whole free slab.
+     * */
+    BufferSlice allocate();
+
+    /** @brief Returns a slice of size bytes (at most slabSize()), carved out of a slab shared by the small allocations,
+     * so that short buffers (for instance, small responses) do not hold a whole slab each. The slab returns to the pool
+     * when all its slices are released.
+     * */
+    BufferSlice allocateSmall(size_t size);
+
+    size_t slabSize() const {
+        return m_slabSize;
+    }
+    /** @brief Returns the number of slabs currently handed out.
+     * */
+    size_t nrSlabsInUse() const;
+
+private:
+    friend class BufferSlice;
+
+    void release(buffer_pool_private::Slab* pSlab);
+    void allocateChunk();
+
+    size_t const m_slabSize;
+    size_t const m_slabsPerChunk;
+    bool const m_useHugePages;
+
+    mutable std::mutex m_mutex;
+    std::vector<buffer_pool_private::Slab*> m_freeSlabs;
+    /** The slab allocateSmall() carves from; the pool holds a reference to it */
+    buffer_pool_private::Slab* m_pSmallSlab = nullptr;
+    size_t m_smallPos = 0;
+    std::vector<std::pair<void*, size_t> > m_chunks;
+    std::vector<std::unique_ptr<buffer_pool_private::Slab[]> > m_slabs;
+    size_t m_nrSlabs = 0;
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "Future.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/** @brief A bounded queue for passing values between tasks, with any number of senders and receivers.
+ *
+ * send() and receive() never block: they return a future that is already completed if the operation could be done
+ * immediately, or that completes later, when a receiver makes room or a sender provides a value. Waiting senders and
+ * receivers are served in FIFO order. A value sent while receivers are waiting is handed directly to the first of them.
+ *
+ * The mutex is held only for moving values and waiters around; the futures are completed after releasing it, so the
+ * continuations never run under the lock.
+ * */
+template<typename T>
+class Channel {
+public:
+    /** @brief Creates an empty channel that buffers at most capacity values (at least 1).
+     * */
+    explicit Channel(size_t capacity)
+        :m_capacity(capacity == 0 ? 1 : capacity)
+        {}
+    Channel(Channel const&) = delete;
+    Channel(Channel&&) = delete;
+    Channel& operator=(Channel const&) = delete;
+    Channel& operator=(Channel&&) = delete;
+
+    /**
+     * @brief Sends a value
+     * @return a future that will be set to true when the value is in the channel, or to false if the channel is (or gets)
+     * closed first; in that case, the value is dropped
+     */
+    Future<bool> send(T value) {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if(m_closed) {
+            return completedFuture(false);
+        }
+        if(m_receivers.empty() && m_buffer.size() < m_capacity) {
+            m_buffer.push_back(std::move(value));
+            return completedFuture(true);
+        }
+        std::vector<T> values;
+        values.push_back(std::move(value));
+        return sendLocked(std::move(values), lck);
+    }
+
+    /** @brief Sends all the values, in order; the future completes when all are in the channel. The values may get
+     * interleaved with those of other senders.
+     * */
+    Future<bool> sendBatch(std::vector<T> values) {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if(m_closed) {
+            return completedFuture(false);
+        }
+        return sendLocked(std::move(values), lck);
+    }
+
+    /**
+     * @brief Receives a value
+     * @return a future that will receive the value, or std::nullopt if the channel is closed and all its values have been received
+     */
+    Future<std::optional<T> > receive() {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if(!m_buffer.empty()) {
+            std::optional<T> ret(std::move(m_buffer.front()));
+            m_buffer.pop_front();
+            Completions completions;
+            refillFromSenders(completions);
+            lck.unlock();
+            runCompletions(completions);
+            return completedFuture(std::move(ret));
+        }
+        if(m_closed) {
+            return completedFuture(std::optional<T>());
+        }
+        Receiver receiver;
+        receiver.pOne = std::make_shared<PromiseFuturePair<std::optional<T> > >();
+        m_receivers.push_back(receiver);
+        return Future<std::optional<T> >(receiver.pOne);
+    }
+
+    /**
+     * @brief Receives between 1 and maxCount values, as soon as there is at least one
+     * @return a future that will receive the values, or no value if the channel is closed and all its values have been received
+     */
+    Future<std::vector<T> > receiveBatch(size_t maxCount) {
+        if(maxCount == 0) {
+            maxCount = 1;
+        }
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if(!m_buffer.empty()) {
+            std::vector<T> ret;
+            ret.reserve(std::min(maxCount, m_buffer.size()));
+            while(ret.size() < maxCount && !m_buffer.empty()) {
+                ret.push_back(std::move(m_buffer.front()));
+                m_buffer.pop_front();
+            }
+            Completions completions;
+            refillFromSenders(completions);
+            lck.unlock();
+            runCompletions(completions);
+            return completedFuture(std::move(ret));
+        }
+        if(m_closed) {
+            return completedFuture(std::vector<T>());
+        }
+        Receiver receiver;
+        receiver.pBatch = std::make_shared<PromiseFuturePair<std::vector<T> > >();
+        receiver.maxCount = maxCount;
+        m_receivers.push_back(receiver);
+        return Future<std::vector<T> >(receiver.pBatch);
+    }
+
+    /** @brief Closes the channel. The values already in the channel can still be received; waiting senders get false,
+     * and waiting receivers get the end of the channel.
+     * */
+    void close() {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        m_closed = true;
+        std::deque<Sender> senders = std::move(m_senders);
+        std::deque<Receiver> receivers = std::move(m_receivers);
+        m_senders.clear();
+        m_receivers.clear();
+        lck.unlock();
+        for(Sender& sender : senders) {
+            sender.pDone->set(false);
+        }
+        for(Receiver& receiver : receivers) {
+            if(receiver.pOne != nullptr) {
+                receiver.pOne->set(std::nullopt);
+            } else {
+                receiver.pBatch->set(std::vector<T>());
+            }
+        }
+    }
+
+    bool isClosed() const {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        return m_closed;
+    }
+
+private:
+    struct Sender {
+        std::vector<T> values;
+        size_t pos = 0;
+        std::shared_ptr<PromiseFuturePair<bool> > pDone;
+    };
+    struct Receiver {
+        std::shared_ptr<PromiseFuturePair<std::optional<T> > > pOne;
+        std::shared_ptr<PromiseFuturePair<std::vector<T> > > pBatch;
+        size_t maxCount = 1;
+    };
+    /** @brief The futures to be completed once the mutex is released.
+     * */
+    struct Completions {
+        std::vector<std::pair<std::shared_ptr<PromiseFuturePair<std::optional<T> > >, T> > ones;
+        std::vector<std::pair<std::shared_ptr<PromiseFuturePair<std::vector<T> > >, std::vector<T> > > batches;
+        std::vector<std::shared_ptr<PromiseFuturePair<bool> > > senders;
+    };
+
+    static void runCompletions(Completions& completions) {
+        for(auto& one : completions.ones) {
+            one.first->set(std::optional<T>(std::move(one.second)));
+        }
+        for(auto& batch : completions.batches) {
+            batch.first->set(std::move(batch.second));
+        }
+        for(auto& pDone : completions.senders) {
+            pDone->set(true);
+        }
+    }
+
+    /** @brief Hands the values to the waiting receivers, then to the buffer, then queues the rest as a waiting sender.
+     * Unlocks lck.
+     * */
+    Future<bool> sendLocked(std::vector<T> values, std::unique_lock<std::mutex>& lck) {
+        Completions completions;
+        size_t pos = 0;
+        // Receivers wait only while the buffer is empty
+        while(pos < values.size() && !m_receivers.empty()) {
+            Receiver receiver = std::move(m_receivers.front());
+            m_receivers.pop_front();
+            if(receiver.pOne != nullptr) {
+                completions.ones.emplace_back(std::move(receiver.pOne), std::move(values[pos]));
+                ++pos;
+            } else {
+                std::vector<T> batch;
+                while(pos < values.size() && batch.size() < receiver.maxCount) {
+                    batch.push_back(std::move(values[pos]));
+                    ++pos;
+                }
+                completions.batches.emplace_back(std::move(receiver.pBatch), std::move(batch));
+            }
+        }
+        while(pos < values.size() && m_buffer.size() < m_capacity && m_senders.empty()) {
+            m_buffer.push_back(std::move(values[pos]));
+            ++pos;
+        }
+        Future<bool> ret = completedFuture(true);
+        if(pos < values.size()) {
+            Sender sender;
+            sender.values = std::move(values);
+            sender.pos = pos;
+            sender.pDone = std::make_shared<PromiseFuturePair<bool> >();
+            ret = Future<bool>(sender.pDone);
+            m_senders.push_back(std::move(sender));
+        }
+        lck.unlock();
+        runCompletions(completions);
+        return ret;
+    }
+
+    /** @brief Moves values from the waiting senders to the buffer, while there is room. Called with the mutex locked.
+     * */
+    void refillFromSenders(Completions& completions) {
+        while(m_buffer.size() < m_capacity && !m_senders.empty()) {
+            Sender& sender = m_senders.front();
+            while(m_buffer.size() < m_capacity && sender.pos < sender.values.size()) {
+                m_buffer.push_back(std::move(sender.values[sender.pos]));
+                ++sender.pos;
+            }
+            if(sender.pos < sender.values.size()) {
+                return;
+            }
+            completions.senders.push_back(std::move(sender.pDone));
+            m_senders.pop_front();
+        }
+    }
+
+    size_t const m_capacity;
+    mutable std::mutex m_mutex;
+    std::deque<T> m_buffer;
+    std::deque<Sender> m_senders;
+    std::deque<Receiver> m_receivers;
+    bool m_closed = false;
+};
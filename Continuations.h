@@ -1,34 +1,129 @@
 #pragma once
 
 #include "AlarmClock.h"
+#include "BlockingExecutor.h"
 #include "Executor.h"
+#include "Expected.h"
 
 template<typename R, typename Func>
 Future<R> launchAsync(Executor& executor, Func func)
 {
     std::shared_ptr<PromiseFuturePair<R> > ret = std::make_shared<PromiseFuturePair<R> >();
-    executor.enqueue([ret,tmpFunc=std::move(func)]() -> void {
-        ret->set(tmpFunc());
+    executor.enqueue([ret,tmpFunc=std::move(func)]() mutable -> void {
+        if constexpr (std::is_void<R>::value) {
+            tmpFunc();
+            ret->set();
+        } else {
+            ret->set(tmpFunc());
+        }
     });
     return Future<R>(ret);
 }
 
+/**
+ * @brief Runs a blocking function on the blocking executor
+ * @param executor The compute executor where the returned future is completed, so that its continuations do not run
+ * on (and do not hold) a blocking thread
+ * @param func The function to be executed; it may block, for instance, in a system call
+ * @return A future that will be completed with the value returned by func (R may be void), or with the exception it throws
+ */
+template<typename R, typename Func>
+Future<R> launchBlocking(Executor& executor, Func func)
+{
+    std::shared_ptr<PromiseFuturePair<R> > ret = std::make_shared<PromiseFuturePair<R> >();
+    blockingExecutor().enqueue([&executor,ret,tmpFunc=std::move(func)]() mutable -> void {
+        if constexpr (std::is_void<R>::value) {
+            std::exception_ptr pEx;
+            try {
+                tmpFunc();
+            } catch(...) {
+                pEx = std::current_exception();
+            }
+            executor.enqueue([ret,pEx]() {
+                if(pEx) {
+                    ret->setException(pEx);
+                } else {
+                    ret->set();
+                }
+            });
+        } else {
+            typename PromiseFuturePair<R>::FutureValueType val;
+            try {
+                val = tmpFunc();
+            } catch(...) {
+                val = std::current_exception();
+            }
+            executor.enqueue([ret,tmpVal=std::move(val)]() mutable {
+                ret->setResult(std::move(tmpVal));
+            });
+        }
+    });
+    return Future<R>(ret);
+}
+
+namespace continuations_private {
+    /**
+     * @brief Completes ret with the result of future, when the latter completes.
+     * @param future The future whose result is to be forwarded. Its value is moved if this is its last Future object.
+     * @param ret The promise to be completed
+     */
+    template<typename R>
+    void forwardResult(Future<R> future, std::shared_ptr<PromiseFuturePair<R> > ret)
+    {
+        std::shared_ptr<PromiseFuturePair<R> > pFutureObject = future.futureObject();
+        if(pFutureObject == nullptr) {
+            ret->setResult(future.takeResult());
+            return;
+        }
+        pFutureObject->addCallback([ret, tmpFuture = std::move(future)](typename Future<R>::FutureValueType const&) {
+            ret->setResult(tmpFuture.takeResult());
+        });
+    }
+
+    /**
+     * @brief Enqueues the continuation on the executor when the future completes
+     * @param pFutureObject The shared state of the future, or nullptr if the future holds its result inline; in that case,
+     * the continuation is enqueued right away
+     */
+    template<typename Arg, typename Continuation>
+    void enqueueWhenReady(Executor& executor, std::shared_ptr<PromiseFuturePair<Arg> > const& pFutureObject, Continuation continuation)
+    {
+        if(pFutureObject == nullptr) {
+            executor.enqueue(std::move(continuation));
+            return;
+        }
+        pFutureObject->addCallback([&executor, tmpContinuation = std::move(continuation)](typename Future<Arg>::FutureValueType const&) mutable -> void {
+            executor.enqueue(std::move(tmpContinuation));
+        });
+    }
+}
+
 /**
  * @brief Adds a simple (synchronous) function as a continuation to a future
  * @param executor An executor that will execute the continuation
- * @param func The function to be executed. It is assumed to execute synchronously and return a simple value (not a future)
+ * @param func The function to be executed. It is assumed to execute synchronously and return a simple value (not a future),
+ * or nothing if R is void
  * @param fArg The future whose completion should trigger the continuation. It will be given as an argument to the function func
  * @return A future that will be completed when the continuation (func) completes
+ *
+ * If the caller does not keep other Future objects referring to the same value as fArg (for instance, by passing a temporary or
+ * using std::move()), the value is moved into func, without being copied.
  */
 template<typename R, typename Func, typename Arg>
 Future<R> addContinuation(Executor& executor, Func func, Future<Arg> fArg)
 {
     std::shared_ptr<PromiseFuturePair<R> > ret = std::make_shared<PromiseFuturePair<R> >();
-    auto continuation = [ret,tmpFunc=std::move(func), fArg]() -> void {
-        typename PromiseFuturePair<Arg>::FutureValueType const& val(fArg.futureObject()->get());
+    std::shared_ptr<PromiseFuturePair<Arg> > pArgObject = fArg.futureObject();
+    auto continuation = [ret,tmpFunc=std::move(func), tmpArg=std::move(fArg)]() mutable -> void {
+        typename PromiseFuturePair<Arg>::FutureValueType val(tmpArg.takeResult());
         if(std::holds_alternative<Arg>(val)) {
             try {
-                ret->set(tmpFunc(std::get<Arg>(val)));
+                if constexpr (std::is_void<R>::value) {
+                    tmpFunc(std::move(std::get<Arg>(val)));
+                    ret->set();
+                } else {
+                    ret->set(tmpFunc(std::move(std::get<Arg>(val))));
+                }
             } catch(...) {
                 ret->setException(std::current_exception());
             }
@@ -36,9 +131,7 @@ Future<R> addContinuation(Executor& executor, Func func, Future<Arg> fArg)
             ret->setException(std::get<std::exception_ptr>(val));
         }
     };
-    fArg.addCallback([&executor, tmpContinuation = std::move(continuation)](typename Future<Arg>::FutureValueType const& ) -> void {
-        executor.enqueue(std::move(tmpContinuation));
-    });
+    continuations_private::enqueueWhenReady(executor, pArgObject, std::move(continuation));
     return Future<R>(ret);
 }
 
@@ -53,12 +146,12 @@ template<typename R, typename Func, typename Arg>
 Future<R> addAsyncContinuation(Executor& executor, Func func, Future<Arg> fArg)
 {
     std::shared_ptr<PromiseFuturePair<R> > ret = std::make_shared<PromiseFuturePair<R> >();
-    auto continuation = [ret, tmpFunc = std::move(func), fArg]() -> void {
-        typename PromiseFuturePair<Arg>::FutureValueType const& val(fArg.futureObject()->get());
+    std::shared_ptr<PromiseFuturePair<Arg> > pArgObject = fArg.futureObject();
+    auto continuation = [ret, tmpFunc = std::move(func), tmpArg=std::move(fArg)]() mutable -> void {
+        typename PromiseFuturePair<Arg>::FutureValueType val(tmpArg.takeResult());
         if(std::holds_alternative<Arg>(val)) {
             try {
-                auto future = tmpFunc(std::get<Arg>(val));
-                future.addCallback([ret](typename Future<R>::FutureValueType const& v) {ret->setResult(v); });
+                continuations_private::forwardResult<R>(tmpFunc(std::move(std::get<Arg>(val))), ret);
             } catch(...) {
                 ret->setException(std::current_exception());
             }
@@ -66,9 +159,7 @@ Future<R> addAsyncContinuation(Executor& executor, Func func, Future<Arg> fArg)
             ret->setException(std::get<std::exception_ptr>(val));
         }
     };
-    fArg.addCallback([&executor, tmpContinuation = std::move(continuation)](typename Future<Arg>::FutureValueType const&) -> void {
-        executor.enqueue(std::move(tmpContinuation));
-    });
+    continuations_private::enqueueWhenReady(executor, pArgObject, std::move(continuation));
     return Future<R>(ret);
 }
 
@@ -83,25 +174,118 @@ template<typename R, typename Func, typename Arg>
 Future<R> catchAsync(Executor& executor, Func func, Future<Arg> fArg)
 {
     std::shared_ptr<PromiseFuturePair<R> > ret = std::make_shared<PromiseFuturePair<R> >();
-    auto continuation = [ret, tmpFunc = std::move(func), fArg]() -> void {
-        typename PromiseFuturePair<Arg>::FutureValueType const& val(fArg.futureObject()->get());
+    std::shared_ptr<PromiseFuturePair<Arg> > pArgObject = fArg.futureObject();
+    auto continuation = [ret, tmpFunc = std::move(func), tmpArg=std::move(fArg)]() mutable -> void {
+        typename PromiseFuturePair<Arg>::FutureValueType val(tmpArg.takeResult());
         if(std::holds_alternative<std::exception_ptr>(val)) {
             try {
-                auto future = tmpFunc(std::get<std::exception_ptr>(val));
-                future.addCallback([ret](typename Future<R>::FutureValueType const& v) {ret->setResult(v); });
+                continuations_private::forwardResult<R>(tmpFunc(std::get<std::exception_ptr>(val)), ret);
             } catch(...) {
                 ret->setException(std::current_exception());
             }
         } else {
-            ret->setResult(val);
+            ret->setResult(std::move(val));
         }
     };
-    fArg.addCallback([&executor, tmpContinuation = std::move(continuation)](typename Future<Arg>::FutureValueType const&) -> void {
-        executor.enqueue(std::move(tmpContinuation));
-    });
+    continuations_private::enqueueWhenReady(executor, pArgObject, std::move(continuation));
     return Future<R>(ret);
 }
 
+/**
+ * @brief Adds a simple (synchronous) function as a continuation to a future holding an Expected value
+ * @param executor An executor that will execute the continuation
+ * @param func The function to be executed. It takes the value in fArg and returns either a simple R or an Expected<R,E>
+ * @param fArg The future whose completion should trigger the continuation
+ * @return A future that will be completed when the continuation (func) completes
+ *
+ * If fArg completes with an error (or an exception), func is not invoked; the error is forwarded to the returned future
+ * directly, without throwing and without going through the executor.
+ */
+template<typename R, typename Func, typename Arg, typename E>
+Future<Expected<R,E> > addExpectedContinuation(Executor& executor, Func func, Future<Expected<Arg,E> > fArg)
+{
+    std::shared_ptr<PromiseFuturePair<Expected<Arg,E> > > pArgObject = fArg.futureObject();
+    if(pArgObject == nullptr) {
+        // fArg holds its result inline: an error is forwarded without allocating anything
+        typename Future<Expected<Arg,E> >::FutureValueType const& val = fArg.result();
+        if(std::holds_alternative<std::exception_ptr>(val)) {
+            return failedFuture<Expected<R,E> >(std::get<std::exception_ptr>(val));
+        } else if(!std::get<Expected<Arg,E> >(val).hasValue()) {
+            return completedFuture(Expected<R,E>(makeUnexpected(std::get<Expected<Arg,E> >(val).error())));
+        }
+    }
+    std::shared_ptr<PromiseFuturePair<Expected<R,E> > > ret = std::make_shared<PromiseFuturePair<Expected<R,E> > >();
+    auto continuation = [ret,tmpFunc=std::move(func), tmpArg=std::move(fArg)]() mutable -> void {
+        typename PromiseFuturePair<Expected<Arg,E> >::FutureValueType val(tmpArg.takeResult());
+        try {
+            ret->set(Expected<R,E>(tmpFunc(std::get<Expected<Arg,E> >(std::move(val)).value())));
+        } catch(...) {
+            ret->setException(std::current_exception());
+        }
+    };
+    if(pArgObject == nullptr) {
+        executor.enqueue(std::move(continuation));
+        return Future<Expected<R,E> >(ret);
+    }
+    pArgObject->addCallback([&executor, ret, tmpContinuation = std::move(continuation)](typename Future<Expected<Arg,E> >::FutureValueType const& val) mutable -> void {
+        if(std::holds_alternative<std::exception_ptr>(val)) {
+            ret->setException(std::get<std::exception_ptr>(val));
+        } else if(!std::get<Expected<Arg,E> >(val).hasValue()) {
+            ret->set(makeUnexpected(std::get<Expected<Arg,E> >(val).error()));
+        } else {
+            executor.enqueue(std::move(tmpContinuation));
+        }
+    });
+    return Future<Expected<R,E> >(ret);
+}
+
+/**
+ * @brief Adds an asynchronous function as a continuation to a future holding an Expected value
+ * @param executor An executor that will execute the continuation
+ * @param func The function to be executed. It takes the value in fArg, starts an asynchronous operation and immediately returns a Future<Expected<R,E> > for it
+ * @param fArg The future whose completion should trigger the continuation
+ * @return A future that will be completed when the continuation (func) completes
+ *
+ * As for addExpectedContinuation(), an error in fArg is forwarded directly, without invoking func.
+ */
+template<typename R, typename Func, typename Arg, typename E>
+Future<Expected<R,E> > addAsyncExpectedContinuation(Executor& executor, Func func, Future<Expected<Arg,E> > fArg)
+{
+    std::shared_ptr<PromiseFuturePair<Expected<Arg,E> > > pArgObject = fArg.futureObject();
+    if(pArgObject == nullptr) {
+        // fArg holds its result inline: an error is forwarded without allocating anything
+        typename Future<Expected<Arg,E> >::FutureValueType const& val = fArg.result();
+        if(std::holds_alternative<std::exception_ptr>(val)) {
+            return failedFuture<Expected<R,E> >(std::get<std::exception_ptr>(val));
+        } else if(!std::get<Expected<Arg,E> >(val).hasValue()) {
+            return completedFuture(Expected<R,E>(makeUnexpected(std::get<Expected<Arg,E> >(val).error())));
+        }
+    }
+    std::shared_ptr<PromiseFuturePair<Expected<R,E> > > ret = std::make_shared<PromiseFuturePair<Expected<R,E> > >();
+    auto continuation = [ret,tmpFunc=std::move(func), tmpArg=std::move(fArg)]() mutable -> void {
+        typename PromiseFuturePair<Expected<Arg,E> >::FutureValueType val(tmpArg.takeResult());
+        try {
+            continuations_private::forwardResult<Expected<R,E> >(tmpFunc(std::get<Expected<Arg,E> >(std::move(val)).value()), ret);
+        } catch(...) {
+            ret->setException(std::current_exception());
+        }
+    };
+    if(pArgObject == nullptr) {
+        executor.enqueue(std::move(continuation));
+        return Future<Expected<R,E> >(ret);
+    }
+    pArgObject->addCallback([&executor, ret, tmpContinuation = std::move(continuation)](typename Future<Expected<Arg,E> >::FutureValueType const& val) mutable -> void {
+        if(std::holds_alternative<std::exception_ptr>(val)) {
+            ret->setException(std::get<std::exception_ptr>(val));
+        } else if(!std::get<Expected<Arg,E> >(val).hasValue()) {
+            ret->set(makeUnexpected(std::get<Expected<Arg,E> >(val).error()));
+        } else {
+            executor.enqueue(std::move(tmpContinuation));
+        }
+    });
+    return Future<Expected<R,E> >(ret);
+}
+
 namespace continuations_private {
     /**
      * @brief Given a completed future start, it executes loopingPredicate on it and, as long as it returns true, it enqueues 
@@ -112,24 +296,26 @@ namespace continuations_private {
      * @param ret
      */
     template<typename R, typename LoopFunc, typename PredicateFunc>
-    void auxLoop(Executor& executor, PredicateFunc loopingPredicate, LoopFunc loopFunc, R const& start, std::shared_ptr<PromiseFuturePair<R> > ret)
+    void auxLoop(Executor& executor, PredicateFunc loopingPredicate, LoopFunc loopFunc, R start, std::shared_ptr<PromiseFuturePair<R> > ret)
     {
         if(!loopingPredicate(start)) {
-            ret->set(start);
+            ret->set(std::move(start));
             return;
         }
 
         try {
-            Future<R> tmpResFuture = loopFunc(start);
-            tmpResFuture.addCallback([&executor,loopingPredicate,loopFunc,tmpResFuture,ret](typename Future<R>::FutureValueType const&){
-                executor.enqueue([&executor,loopingPredicate,loopFunc,tmpResFuture,ret](){
-                    typename PromiseFuturePair<R>::FutureValueType const& val(tmpResFuture.futureObject()->get());
-                    if(std::holds_alternative<R>(val)) {
-                        auxLoop(executor, loopingPredicate, loopFunc, std::get<R>(val), ret);
-                    } else {
-                        ret->setException(std::get<std::exception_ptr>(val));
-                    }
-                });
+            Future<R> tmpResFuture = loopFunc(std::move(start));
+            std::shared_ptr<PromiseFuturePair<R> > pResObject = tmpResFuture.futureObject();
+            // The next iteration always goes through the executor, even if the result is already available, so that a
+            // long loop does not grow the stack
+            enqueueWhenReady(executor, pResObject, [&executor,tmpPredicate=std::move(loopingPredicate),tmpLoopFunc=std::move(loopFunc),
+                    tmpResFuture=std::move(tmpResFuture),ret]() mutable {
+                typename PromiseFuturePair<R>::FutureValueType val(tmpResFuture.takeResult());
+                if(std::holds_alternative<R>(val)) {
+                    auxLoop(executor, std::move(tmpPredicate), std::move(tmpLoopFunc), std::move(std::get<R>(val)), ret);
+                } else {
+                    ret->setException(std::get<std::exception_ptr>(val));
+                }
             });
         } catch(...) {
             ret->setException(std::current_exception());
@@ -150,10 +336,10 @@ namespace continuations_private {
  * the retuned future. Otherwise, loopFunc(start) is invoked and its result is treated as if it were start
  */
 template<typename R, typename LoopFunc, typename PredicateFunc>
-Future<R> executeAsyncLoop(Executor& executor, PredicateFunc loopingPredicate, LoopFunc loopFunc, R const& start)
+Future<R> executeAsyncLoop(Executor& executor, PredicateFunc loopingPredicate, LoopFunc loopFunc, R start)
 {
     std::shared_ptr<PromiseFuturePair<R> > ret = std::make_shared<PromiseFuturePair<R> >();
-    continuations_private::auxLoop(executor, loopingPredicate, loopFunc, start, ret);
+    continuations_private::auxLoop(executor, std::move(loopingPredicate), std::move(loopFunc), std::move(start), ret);
     return Future<R>(ret);
 }
 
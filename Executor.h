@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
 
 /** @brief Simple executor interface.
@@ -11,4 +12,10 @@ public:
     /** @brief adds an action to be executed at a later time.
      * */
     virtual void enqueue(std::function<void()> func) = 0;
+
+    /** @brief returns a hint of how many enqueued actions can execute in parallel.
+     * */
+    virtual size_t concurrency() const {
+        return 1;
+    }
 };
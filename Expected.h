@@ -0,0 +1,75 @@
+#pragma once
+
+#include <utility>
+#include <variant>
+
+/** @brief Wrapper marking a value as an error, used for constructing an Expected holding an error.
+ * */
+template<typename E>
+class Unexpected {
+public:
+    explicit Unexpected(E error)
+        :m_error(std::move(error))
+        {}
+
+    E const& error() const {
+        return m_error;
+    }
+    E& error() {
+        return m_error;
+    }
+private:
+    E m_error;
+};
+
+template<typename E>
+Unexpected<E> makeUnexpected(E error) {
+    return Unexpected<E>(std::move(error));
+}
+
+/** @brief Holds either a value of type T or an error of type E.
+ *
+ * Meant to be used as Future<Expected<T,E> > for operations with expected failures (end of stream, parse errors),
+ * so that such failures propagate through the continuations as ordinary values, without throwing exceptions.
+ * Exceptions remain reserved for unexpected failures.
+ * */
+template<typename T, typename E>
+class Expected {
+public:
+    using ValueType = T;
+    using ErrorType = E;
+
+    Expected(T value)
+        :m_val(std::in_place_index<0>, std::move(value))
+        {}
+    Expected(Unexpected<E> error)
+        :m_val(std::in_place_index<1>, std::move(error.error()))
+        {}
+
+    bool hasValue() const {
+        return m_val.index() == 0;
+    }
+    explicit operator bool() const {
+        return hasValue();
+    }
+
+    /** @brief Returns the value. Must be called only if hasValue() is true.
+     * */
+    T const& value() const& {
+        return std::get<0>(m_val);
+    }
+    T& value() & {
+        return std::get<0>(m_val);
+    }
+    T&& value() && {
+        return std::get<0>(std::move(m_val));
+    }
+
+    /** @brief Returns the error. Must be called only if hasValue() is false.
+     * */
+    E const& error() const {
+        return std::get<1>(m_val);
+    }
+private:
+    std::variant<T,E> m_val;
+};
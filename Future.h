@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <exception>
 #include <functional>
@@ -7,6 +8,7 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <type_traits>
 #include <variant>
 
 enum class FutureCompletionState {
@@ -91,11 +93,24 @@ public:
             }
         });
     }
+
+    /** @brief Number of Future<T> objects referring to this; maintained by Future<T>.
+     * */
+    size_t nrFutureHandles() const {
+        return m_nrFutureHandles.load(std::memory_order_acquire);
+    }
+    void addFutureHandle() {
+        m_nrFutureHandles.fetch_add(1, std::memory_order_relaxed);
+    }
+    void releaseFutureHandle() {
+        m_nrFutureHandles.fetch_sub(1, std::memory_order_acq_rel);
+    }
 private:
     mutable std::mutex m_mutex;
     mutable std::condition_variable m_cv;
     FutureValueType m_val;
     std::list<CallbackType> m_callbacks;
+    std::atomic<size_t> m_nrFutureHandles{0};
 };
 
 template<>
@@ -158,6 +173,13 @@ private:
 /** Future with base type T.
  * 
  * Essentially, it is a wrapper over a shared pointer to a PromiseFuturePair<T>
+ *
+ * The Future objects referring to the same PromiseFuturePair are counted. When only one of them remains, it is the sole
+ * consumer of the value, and takeResult() (used by the continuation functions) moves the value out instead of copying it.
+ *
+ * A future created already completed (by completedFuture() or failedFuture()) holds its value or exception inline,
+ * without any PromiseFuturePair, so that synchronous results cost no allocation and no locking. Copying such a future
+ * copies the value; therefore, a value of a type that cannot be copied is always kept in a PromiseFuturePair.
  * */
 template<typename T>
 class Future {
@@ -167,48 +189,144 @@ public:
     using CommonCallbackType = typename PromiseFuturePairBase::CommonCallbackType;
     
     explicit Future(std::shared_ptr<PromiseFuturePair<T> > pFuture)
-        :m_pFuture(pFuture)
+        :m_pFuture(std::move(pFuture))
+    {
+        if(m_pFuture) {
+            m_pFuture->addFutureHandle();
+        }
+    }
+    Future(Future const& other)
+        :m_pFuture(other.m_pFuture),
+        m_result(copyInlineResult(other.m_result))
+    {
+        if(m_pFuture) {
+            m_pFuture->addFutureHandle();
+        }
+    }
+    Future(Future&& other) noexcept
+        :m_pFuture(std::move(other.m_pFuture)),
+        m_result(std::move(other.m_result))
         {}
+    Future& operator=(Future const& other) {
+        Future tmp(other);
+        std::swap(m_pFuture, tmp.m_pFuture);
+        std::swap(m_result, tmp.m_result);
+        return *this;
+    }
+    Future& operator=(Future&& other) noexcept {
+        std::swap(m_pFuture, other.m_pFuture);
+        std::swap(m_result, other.m_result);
+        return *this;
+    }
+    ~Future() {
+        if(m_pFuture) {
+            m_pFuture->releaseFutureHandle();
+        }
+    }
 
     /** @brief Waits until the future completes, then returns the value, or throws the exception if the future completes with an exception.
      * */
     T const& get() const {
-        FutureValueType const& val(m_pFuture->get());
+        FutureValueType const& val(result());
         if(std::holds_alternative<T>(val)) {
             return std::get<T>(val);
         }
         std::rethrow_exception(std::get<std::exception_ptr>(val));
     }
     T getMove() const {
-        FutureValueType val = m_pFuture->getMove();
+        FutureValueType val = m_pFuture ? m_pFuture->getMove() : std::move(m_result);
         if(std::holds_alternative<T>(val)) {
             return std::move(std::get<T>(val));
         }
         std::rethrow_exception(std::get<std::exception_ptr>(val));
     }
+
+    /** @brief Waits until the future completes, then returns its result (the value or the exception), without throwing.
+     * */
+    FutureValueType const& result() const {
+        return m_pFuture ? m_pFuture->get() : m_result;
+    }
+
+    /** @brief Waits until the future completes, then returns its result. If this is the only Future referring to the result
+     * (or if T cannot be copied), the value is moved out; otherwise, it is copied, so that the other Future objects still see it.
+     * */
+    FutureValueType takeResult() const {
+        if(!m_pFuture) {
+            return std::move(m_result);
+        }
+        if constexpr (std::is_copy_constructible<T>::value) {
+            if(m_pFuture->nrFutureHandles() != 1) {
+                return m_pFuture->get();
+            }
+        }
+        return m_pFuture->getMove();
+    }
     
     /** @brief Adds a callback that will execute when the future completes. If the future is already completed, the callback
      * executes on the current thread; otherwise, the callback will execute on the thread that completes the future.
      * */
     void addCallback(CallbackType callback) const {
-        m_pFuture->addCallback(callback);
+        if(!m_pFuture) {
+            callback(m_result);
+            return;
+        }
+        m_pFuture->addCallback(std::move(callback));
     }
     /** @brief Adds a callback that will execute when the future completes. If the future is already completed, the callback
      * executes on the current thread; otherwise, the callback will execute on the thread that completes the future.
      * */
     void addCommonCallback(CommonCallbackType callback) const {
-        m_pFuture->addCommonCallback(callback);
+        if(!m_pFuture) {
+            if(std::holds_alternative<T>(m_result)) {
+                callback(FutureCompletionState::completedNormally, nullptr);
+            } else {
+                callback(FutureCompletionState::exception, std::get<std::exception_ptr>(m_result));
+            }
+            return;
+        }
+        m_pFuture->addCommonCallback(std::move(callback));
     }
     /** @brief Waits until the future completes.
      * */
     void wait() const {
-        m_pFuture->wait();
+        if(m_pFuture) {
+            m_pFuture->wait();
+        }
     }
+    /** @brief Returns true if the future has already completed, normally or with an exception.
+     * */
+    bool isReady() const {
+        return !m_pFuture || m_pFuture->isReady();
+    }
+    /** @brief Returns the shared state of the future, or nullptr if the future was created completed and holds its result inline.
+     * */
     std::shared_ptr<PromiseFuturePair<T> > futureObject() const {
         return m_pFuture;
     }
 private:
+    template<typename U>
+    friend Future<U> completedFuture(U val);
+    template<typename U>
+    friend Future<U> failedFuture(std::exception_ptr pEx);
+
+    /** @brief Creates a completed future, holding its result inline.
+     * */
+    explicit Future(FutureValueType result)
+        :m_result(std::move(result))
+        {}
+
+    static FutureValueType copyInlineResult(FutureValueType const& result) {
+        if constexpr (std::is_copy_constructible<T>::value) {
+            return result;
+        } else {
+            return FutureNotCompletedTag();
+        }
+    }
+
     std::shared_ptr<PromiseFuturePair<T> > m_pFuture;
+    /** The result of a future created completed, if m_pFuture is null. Mutable, because takeResult() and getMove() move
+     * it out, as they do with the result in the shared state. */
+    mutable FutureValueType m_result;
 };
 
 template<>
@@ -219,34 +337,82 @@ public:
         :m_pFuture(pFuture)
         {}
 
+    /** @brief Creates a future that completes when f completes. It does not count as a consumer of the value of f.
+     * */
     template<typename T>
     Future(Future<T> const& f)
         :m_pFuture(f.futureObject())
-        {}
+    {
+        if(!m_pFuture) {
+            // f holds its result inline, so the callback runs right away
+            f.addCommonCallback([this](FutureCompletionState state, std::exception_ptr pEx) {
+                m_state = state;
+                m_pException = std::move(pEx);
+            });
+        }
+    }
 
     void addCommonCallback(CommonCallbackType callback) {
-        m_pFuture->addCommonCallback(callback);
+        if(!m_pFuture) {
+            callback(m_state, m_pException);
+            return;
+        }
+        m_pFuture->addCommonCallback(std::move(callback));
     }
     void wait() {
-        m_pFuture->wait();
+        if(m_pFuture) {
+            m_pFuture->wait();
+        }
     }
+    bool isReady() const {
+        return !m_pFuture || m_pFuture->isReady();
+    }
+    /** @brief Returns the shared state of the future, or nullptr if the future was created completed.
+     * */
     std::shared_ptr<PromiseFuturePairBase> futureObject() {
         return m_pFuture;
     }
 private:
+    friend Future<void> completedFuture();
+
+    Future(FutureCompletionState state, std::exception_ptr pException)
+        :m_state(state),
+        m_pException(std::move(pException))
+        {}
+
     std::shared_ptr<PromiseFuturePairBase> m_pFuture;
+    /** The result of a future created completed, if m_pFuture is null */
+    FutureCompletionState m_state = FutureCompletionState::nonCompleted;
+    std::exception_ptr m_pException;
 };
 
+/** @brief Returns a future already completed with val. It holds val inline, unless T cannot be copied.
+ * */
 template<typename T>
 Future<T> completedFuture(T val) {
-    std::shared_ptr<PromiseFuturePair<T> > ret = std::make_shared<PromiseFuturePair<T> >();
-    ret->set(std::move(val));
-    return Future<T>(ret);
+    if constexpr (std::is_copy_constructible<T>::value) {
+        return Future<T>(typename Future<T>::FutureValueType(std::in_place_index<1>, std::move(val)));
+    } else {
+        std::shared_ptr<PromiseFuturePair<T> > ret = std::make_shared<PromiseFuturePair<T> >();
+        ret->set(std::move(val));
+        return Future<T>(ret);
+    }
+}
+
+/** @brief Returns a future already completed with an exception. It holds the exception inline, unless T cannot be copied.
+ * */
+template<typename T>
+Future<T> failedFuture(std::exception_ptr pEx) {
+    if constexpr (std::is_copy_constructible<T>::value) {
+        return Future<T>(typename Future<T>::FutureValueType(std::in_place_index<2>, std::move(pEx)));
+    } else {
+        std::shared_ptr<PromiseFuturePair<T> > ret = std::make_shared<PromiseFuturePair<T> >();
+        ret->setException(std::move(pEx));
+        return Future<T>(ret);
+    }
 }
 
 inline
 Future<void> completedFuture() {
-    std::shared_ptr<PromiseFuturePair<void> > ret = std::make_shared<PromiseFuturePair<void> >();
-    ret->set();
-    return Future<void>(ret);
+    return Future<void>(FutureCompletionState::completedNormally, nullptr);
 }
@@ -10,6 +10,7 @@ void FutureWaiter::callback(int index) {
     if(m_waitList[index].second) {
         m_waitList[index].second = false;
         m_waitList[index].first = nullptr;
+        m_freeIndices.push_back(index);
         --m_nrActive;
         if(0 == m_nrActive) {
             m_cv.notify_all();
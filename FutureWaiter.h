@@ -3,6 +3,7 @@
 #include "Future.h"
 #include <condition_variable>
 #include <mutex>
+#include <vector>
 
 /** @brief An object holding futures that correspond to "fire and forget" operations.
  * 
@@ -15,21 +16,26 @@ public:
      * */
     template<typename T>
     void addToWaitList(Future<T> f) {
+        if(f.isReady()) {
+            // Nothing to keep alive; this also covers the futures holding their result inline, which have no shared state
+            return;
+        }
+        std::shared_ptr<PromiseFuturePairBase> pFutureObject = f.futureObject();
         std::unique_lock<std::mutex> lck(m_mutex);
         size_t index;
-        for(index=0 ; index < m_waitList.size() ; ++index) {
-            if(!m_waitList[index].second) break;
-        }
-        if(index >= m_waitList.size()) {
-            m_waitList.emplace_back(f.futureObject(), true);
+        if(m_freeIndices.empty()) {
+            index = m_waitList.size();
+            m_waitList.emplace_back(pFutureObject, true);
         } else {
-            m_waitList[index].first = f.futureObject();
+            index = m_freeIndices.back();
+            m_freeIndices.pop_back();
+            m_waitList[index].first = pFutureObject;
             m_waitList[index].second = true;
         }
         ++m_nrActive;
         //std::cout << "Added client " << index << "\n";
         lck.unlock();
-        m_waitList[index].first->addCommonCallback([this,index](FutureCompletionState state, std::exception_ptr){
+        pFutureObject->addCommonCallback([this,index](FutureCompletionState state, std::exception_ptr){
             switch(state) {
             case FutureCompletionState::completedNormally:
                 //std::cout << "Client " << index << " terminated normally\n";
@@ -55,5 +61,6 @@ private:
     std::mutex m_mutex;
     std::condition_variable m_cv;
     std::vector<std::pair<std::shared_ptr<PromiseFuturePairBase> ,bool> > m_waitList;
+    std::vector<size_t> m_freeIndices;
     size_t m_nrActive = 0;
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Continuations.h"
+
+#include <type_traits>
+#include <utility>
+
+/** @brief A chain of synchronous transformations applied to a value of type Arg.
+ *
+ * Each then() composes the new stage with the previous ones at compile time, into a single callable; no future, shared
+ * state or task is created for the intermediate results. The pipeline does nothing until it is started on an executor
+ * (start() or attach()), which costs a single task and a single PromiseFuturePair, however many stages it has. A stage
+ * may return void; the stage that follows it, if any, then takes no argument.
+ *
+ * Example:
+ *   Future<int> f2 = lazyPipeline<int>().then([](int a){return a + 2;}).then([](int a){return 2 * a;}).attach(executor, f1);
+ * */
+template<typename Arg, typename Func>
+class LazyPipeline {
+public:
+    using ResultType = std::invoke_result_t<Func&, Arg>;
+
+    explicit LazyPipeline(Func func)
+        :m_func(std::move(func))
+        {}
+
+    /** @brief Returns a pipeline that applies func to the result of this one (or calls func() if this one returns void).
+     * */
+    template<typename NextFunc>
+    auto then(NextFunc func) && {
+        auto fused = [prev = std::move(m_func), next = std::move(func)](Arg arg) mutable {
+            if constexpr (std::is_void<ResultType>::value) {
+                prev(std::move(arg));
+                return next();
+            } else {
+                return next(prev(std::move(arg)));
+            }
+        };
+        return LazyPipeline<Arg, decltype(fused)>(std::move(fused));
+    }
+
+    /** @brief Runs the whole pipeline synchronously, on the current thread.
+     * */
+    ResultType operator()(Arg arg) {
+        return m_func(std::move(arg));
+    }
+
+    /** @brief Runs the pipeline, as a single task on the executor, on the given value.
+     * */
+    Future<ResultType> start(Executor& executor, Arg arg) && {
+        return launchAsync<ResultType>(executor, [tmpFunc = std::move(m_func), tmpArg = std::move(arg)]() mutable {
+            return tmpFunc(std::move(tmpArg));
+        });
+    }
+
+    /** @brief Runs the pipeline, as a single continuation, on the value of fArg when it completes.
+     * */
+    Future<ResultType> attach(Executor& executor, Future<Arg> fArg) && {
+        return addContinuation<ResultType>(executor, std::move(m_func), std::move(fArg));
+    }
+
+private:
+    Func m_func;
+};
+
+namespace continuations_private {
+    template<typename Arg>
+    struct LazyIdentity {
+        Arg operator()(Arg arg) const {
+            return arg;
+        }
+    };
+}
+
+/** @brief Creates an empty pipeline, taking a value of type Arg, to which stages are to be added by then().
+ * */
+template<typename Arg>
+LazyPipeline<Arg, continuations_private::LazyIdentity<Arg> > lazyPipeline()
+{
+    return LazyPipeline<Arg, continuations_private::LazyIdentity<Arg> >(continuations_private::LazyIdentity<Arg>());
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "Executor.h"
+#include "Future.h"
+
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace parallel_private {
+    /** @brief Number of chunks per thread of the executor, so that faster threads can pick up the remainders.
+     * */
+    size_t const chunksPerThread = 8;
+
+    /**
+     * @brief Computes in how many chunks a range of nrElements is to be split
+     * @param grainSize The minimum number of elements in a chunk; 0 means that it is to be derived from the executor concurrency
+     */
+    inline size_t nrChunks(Executor const& executor, size_t nrElements, size_t grainSize) {
+        size_t maxChunks = executor.concurrency() * chunksPerThread;
+        if(grainSize != 0 && nrElements / grainSize < maxChunks) {
+            maxChunks = nrElements / grainSize;
+        }
+        if(maxChunks == 0) {
+            return 1;
+        }
+        return maxChunks < nrElements ? maxChunks : nrElements;
+    }
+
+    /** @brief The state shared by the tasks of one parallel operation.
+     *
+     * The range is divided in nrChunks chunks; chunkFunc(i) processes chunk i, and finishFunc(pEx) is called exactly once,
+     * after all chunks are processed, with the first exception thrown by a chunk (or nullptr).
+     * */
+    template<typename ChunkFunc, typename FinishFunc>
+    class ChunkedRun {
+    public:
+        ChunkedRun(Executor& executor, size_t nrChunks, ChunkFunc chunkFunc, FinishFunc finishFunc)
+            :m_executor(executor),
+            m_chunkFunc(std::move(chunkFunc)),
+            m_finishFunc(std::move(finishFunc)),
+            m_nrRemaining(nrChunks)
+            {}
+
+        /** @brief Processes chunks [first,last). The upper half is repeatedly handed over to the executor, so that
+         * idle workers can take it, until a single chunk remains, which is processed on the current thread.
+         * */
+        static void run(std::shared_ptr<ChunkedRun> pThis, size_t first, size_t last) {
+            while(last - first > 1) {
+                size_t mid = first + (last - first) / 2;
+                pThis->m_executor.enqueue([pThis,mid,last](){run(pThis, mid, last);});
+                last = mid;
+            }
+            if(!pThis->m_failed.load(std::memory_order_relaxed)) {
+                try {
+                    pThis->m_chunkFunc(first);
+                } catch(...) {
+                    if(!pThis->m_failed.exchange(true)) {
+                        pThis->m_pEx = std::current_exception();
+                    }
+                }
+            }
+            if(pThis->m_nrRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                pThis->m_finishFunc(pThis->m_pEx);
+            }
+        }
+    private:
+        Executor& m_executor;
+        ChunkFunc m_chunkFunc;
+        FinishFunc m_finishFunc;
+        std::atomic<size_t> m_nrRemaining;
+        std::atomic<bool> m_failed{false};
+        std::exception_ptr m_pEx;
+    };
+
+    /** @brief Splits nrElements in chunks and calls rangeFunc(chunkIndex, begin, end) for each chunk, in parallel.
+     * */
+    template<typename RangeFunc, typename FinishFunc>
+    void runChunked(Executor& executor, size_t nrElements, size_t nrChunks, RangeFunc rangeFunc, FinishFunc finishFunc) {
+        auto chunkFunc = [nrElements,nrChunks,tmpRangeFunc=std::move(rangeFunc)](size_t chunk) {
+            tmpRangeFunc(chunk, chunk * nrElements / nrChunks, (chunk + 1) * nrElements / nrChunks);
+        };
+        using RunType = ChunkedRun<decltype(chunkFunc), FinishFunc>;
+        std::shared_ptr<RunType> pRun = std::make_shared<RunType>(executor, nrChunks, std::move(chunkFunc), std::move(finishFunc));
+        executor.enqueue([pRun,nrChunks](){RunType::run(pRun, 0, nrChunks);});
+    }
+
+    inline void setVoidResult(PromiseFuturePair<void>& ret, std::exception_ptr pEx) {
+        if(pEx) {
+            ret.setException(pEx);
+        } else {
+            ret.set();
+        }
+    }
+}
+
+/**
+ * @brief Calls func(i) for each i in [first,last), in parallel
+ * @param executor The executor on which the work is done
+ * @param first The first index
+ * @param last The index past the end of the range
+ * @param func The function to be called; it must be safe to call it concurrently from several threads
+ * @param grainSize The minimum number of indices processed by one task; 0 for choosing it from the executor concurrency
+ * @return A future that completes when all calls complete, or with the first exception thrown by func
+ */
+template<typename Func>
+Future<void> parallelFor(Executor& executor, size_t first, size_t last, Func func, size_t grainSize = 0)
+{
+    if(last <= first) {
+        return completedFuture();
+    }
+    std::shared_ptr<PromiseFuturePair<void> > ret = std::make_shared<PromiseFuturePair<void> >();
+    size_t nrElements = last - first;
+    parallel_private::runChunked(executor, nrElements, parallel_private::nrChunks(executor, nrElements, grainSize),
+        [first,tmpFunc=std::move(func)](size_t, size_t begin, size_t end) {
+            for(size_t i = first + begin ; i < first + end ; ++i) {
+                tmpFunc(i);
+            }
+        },
+        [ret](std::exception_ptr pEx) {parallel_private::setVoidResult(*ret, pEx);});
+    return Future<void>(ret);
+}
+
+/**
+ * @brief Stores func(*it) into the corresponding position of the output range, for each it in [first,last), in parallel
+ * @param executor The executor on which the work is done
+ * @param first Random access iterator to the beginning of the input range
+ * @param last Random access iterator to the end of the input range
+ * @param out Random access iterator to the beginning of the output range
+ * @param func The function to be called; it must be safe to call it concurrently from several threads
+ * @param grainSize The minimum number of elements processed by one task; 0 for choosing it from the executor concurrency
+ * @return A future that completes when the whole output range is written, or with the first exception thrown by func
+ *
+ * Both ranges must stay valid until the returned future completes.
+ */
+template<typename InputIt, typename OutputIt, typename Func>
+Future<void> parallelTransform(Executor& executor, InputIt first, InputIt last, OutputIt out, Func func, size_t grainSize = 0)
+{
+    if(last <= first) {
+        return completedFuture();
+    }
+    std::shared_ptr<PromiseFuturePair<void> > ret = std::make_shared<PromiseFuturePair<void> >();
+    size_t nrElements = size_t(last - first);
+    parallel_private::runChunked(executor, nrElements, parallel_private::nrChunks(executor, nrElements, grainSize),
+        [first,out,tmpFunc=std::move(func)](size_t, size_t begin, size_t end) {
+            OutputIt dest = out + begin;
+            for(InputIt it = first + begin ; it != first + end ; ++it, ++dest) {
+                *dest = tmpFunc(*it);
+            }
+        },
+        [ret](std::exception_ptr pEx) {parallel_private::setVoidResult(*ret, pEx);});
+    return Future<void>(ret);
+}
+
+/**
+ * @brief Computes init op x1 op x2 ... op xn for the elements of [first,last), in parallel
+ * @param executor The executor on which the work is done
+ * @param first Random access iterator to the beginning of the range
+ * @param last Random access iterator to the end of the range
+ * @param init The initial value
+ * @param op The binary operation; it must be associative (it need not be commutative) and safe to call concurrently
+ * @param grainSize The minimum number of elements processed by one task; 0 for choosing it from the executor concurrency
+ * @return A future that completes with the result, or with the first exception thrown by op
+ */
+template<typename It, typename T, typename BinaryOp>
+Future<T> parallelReduce(Executor& executor, It first, It last, T init, BinaryOp op, size_t grainSize = 0)
+{
+    if(last <= first) {
+        return completedFuture<T>(std::move(init));
+    }
+    std::shared_ptr<PromiseFuturePair<T> > ret = std::make_shared<PromiseFuturePair<T> >();
+    size_t nrElements = size_t(last - first);
+    size_t nrChunks = parallel_private::nrChunks(executor, nrElements, grainSize);
+    // Each chunk writes its own partial result; they are combined in order, so that op need not be commutative
+    std::shared_ptr<std::vector<std::optional<T> > > pPartials = std::make_shared<std::vector<std::optional<T> > >(nrChunks);
+    parallel_private::runChunked(executor, nrElements, nrChunks,
+        [first,op,pPartials](size_t chunk, size_t begin, size_t end) {
+            It it = first + begin;
+            T acc = *it;
+            for(++it ; it != first + end ; ++it) {
+                acc = op(std::move(acc), *it);
+            }
+            (*pPartials)[chunk] = std::move(acc);
+        },
+        [ret,op,pPartials,tmpInit=std::move(init)](std::exception_ptr pEx) mutable {
+            if(pEx) {
+                ret->setException(pEx);
+                return;
+            }
+            try {
+                T result = std::move(tmpInit);
+                for(std::optional<T>& partial : *pPartials) {
+                    result = op(std::move(result), std::move(*partial));
+                }
+                ret->set(std::move(result));
+            } catch(...) {
+                ret->setException(std::current_exception());
+            }
+        });
+    return Future<T>(ret);
+}
@@ -0,0 +1,142 @@
+#include "ReplaySocket.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    uint64_t const fnvOffsetBasis = 14695981039346656037ull;
+    uint64_t const fnvPrime = 1099511628211ull;
+}
+
+ReplayCapture::ReplayCapture(char const* data, size_t size)
+    :m_data(data),
+    m_size(size)
+{
+    // empty
+}
+
+ReplayCapture::~ReplayCapture() {
+    if(m_size != 0) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+std::shared_ptr<ReplayCapture> mapReplayCapture(char const* path) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        perror("open()");
+        return nullptr;
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0) {
+        perror("fstat()");
+        ::close(fd);
+        return nullptr;
+    }
+    size_t size = size_t(st.st_size);
+    void* data = nullptr;
+    // mmap() rejects empty mappings; an empty capture is just an immediate end-of-file
+    if(size != 0) {
+        data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if(data == MAP_FAILED) {
+            perror("mmap()");
+            ::close(fd);
+            return nullptr;
+        }
+        ::madvise(data, size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+    return std::shared_ptr<ReplayCapture>(new ReplayCapture(static_cast<char const*>(data), size));
+}
+
+ReplaySocket::ReplaySocket(std::shared_ptr<ReplayCapture const> pCapture, size_t maxChunkSize, bool randomChunkSizes, uint32_t seed)
+    :m_pCapture(std::move(pCapture)),
+    m_maxChunkSize(maxChunkSize == 0 ? 1 : maxChunkSize),
+    m_randomChunkSizes(randomChunkSizes),
+    m_randomState(seed == 0 ? 1 : seed),
+    m_checksum(fnvOffsetBasis)
+{
+    // empty
+}
+
+size_t ReplaySocket::nextChunk(size_t len) {
+    size_t chunkSize = m_maxChunkSize;
+    if(m_randomChunkSizes) {
+        // xorshift32
+        m_randomState ^= m_randomState << 13;
+        m_randomState ^= m_randomState >> 17;
+        m_randomState ^= m_randomState << 5;
+        chunkSize = 1 + m_randomState % m_maxChunkSize;
+    }
+    size_t ret = std::min({chunkSize, len, m_pCapture->size() - m_readPos});
+    m_readPos += ret;
+    return ret;
+}
+
+void ReplaySocket::addSent(char const* data, size_t len) {
+    for(size_t i = 0 ; i < len ; ++i) {
+        m_checksum = (m_checksum ^ uint8_t(data[i])) * fnvPrime;
+    }
+    m_bytesSent += len;
+}
+
+Future<ssize_t> ReplaySocket::recv(void* data, size_t len) {
+    size_t pos = m_readPos;
+    size_t n = nextChunk(len);
+    memcpy(data, m_pCapture->data() + pos, n);
+    return completedFuture<ssize_t>(ssize_t(n));
+}
+
+Future<ssize_t> ReplaySocket::recv(BufferPool& pool, BufferSlice* pSlice) {
+    if(m_readPos == m_pCapture->size()) {
+        return completedFuture<ssize_t>(0);
+    }
+    *pSlice = pool.allocate();
+    return recv(pSlice->data(), pSlice->size());
+}
+
+Future<bool> ReplaySocket::send(void const* data, size_t len) {
+    addSent(static_cast<char const*>(data), len);
+    ++m_nrSends;
+    return completedFuture(true);
+}
+
+Future<bool> ReplaySocket::send(std::shared_ptr<std::string const> pStr) {
+    return send(pStr->data(), pStr->size());
+}
+
+Future<bool> ReplaySocket::send(BufferSlice slice) {
+    return send(slice.data(), slice.size());
+}
+
+Future<bool> ReplaySocket::send(std::vector<BufferSlice> slices) {
+    for(BufferSlice const& slice : slices) {
+        addSent(slice.data(), slice.size());
+    }
+    ++m_nrSends;
+    return completedFuture(true);
+}
+
+Future<ssize_t> ReplaySocket::sendFile(int fd, off_t offset, size_t len) {
+    char buf[16384];
+    size_t total = 0;
+    while(total < len) {
+        ssize_t n = ::pread(fd, buf, std::min(sizeof(buf), len - total), offset + off_t(total));
+        if(n < 0) {
+            perror("pread()");
+            return completedFuture<ssize_t>(-1);
+        }
+        if(n == 0) {
+            break;
+        }
+        addSent(buf, size_t(n));
+        total += size_t(n);
+    }
+    ++m_nrSends;
+    return completedFuture<ssize_t>(ssize_t(total));
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Socket.h"
+
+#include <cstdint>
+#include <memory>
+
+/** @brief A read-only memory mapping of a capture file: the raw bytes sent by a client over one connection.
+ * */
+class ReplayCapture {
+public:
+    ReplayCapture(ReplayCapture const&) = delete;
+    ReplayCapture(ReplayCapture&&) = delete;
+    ReplayCapture& operator=(ReplayCapture const&) = delete;
+    ReplayCapture& operator=(ReplayCapture&&) = delete;
+    ~ReplayCapture();
+
+    char const* data() const {
+        return m_data;
+    }
+    size_t size() const {
+        return m_size;
+    }
+
+private:
+    friend std::shared_ptr<ReplayCapture> mapReplayCapture(char const* path);
+
+    ReplayCapture(char const* data, size_t size);
+
+    char const* const m_data;
+    size_t const m_size;
+};
+
+/** @brief Maps a capture file into memory. Returns nullptr on failure.
+ * */
+std::shared_ptr<ReplayCapture> mapReplayCapture(char const* path);
+
+/** @brief A Socket that replays a capture instead of talking to the network, for benchmarking the request path alone.
+ *
+ * recv() copies the next chunk of the capture and returns an already completed future; after the end of the capture, it
+ * returns end-of-file. The chunks are at most maxChunkSize bytes, or of random sizes between 1 and maxChunkSize, to
+ * simulate the fragmentation of TCP segments; the random sizes are reproducible for a given seed. The sent data is
+ * discarded, after being accumulated in a checksum, so that the responses can be compared between runs.
+ *
+ * The operations are not thread-safe, but may be called from different threads if they are not called concurrently
+ * (for instance, from a Strand).
+ * */
+class ReplaySocket : public Socket {
+public:
+    ReplaySocket(std::shared_ptr<ReplayCapture const> pCapture, size_t maxChunkSize, bool randomChunkSizes = false, uint32_t seed = 1);
+
+    Future<ssize_t> recv(void* data, size_t len) override;
+    Future<ssize_t> recv(BufferPool& pool, BufferSlice* pSlice) override;
+
+    Future<bool> send(void const* data, size_t len) override;
+    Future<bool> send(std::shared_ptr<std::string const> pStr) override;
+    Future<bool> send(BufferSlice slice) override;
+    Future<bool> send(std::vector<BufferSlice> slices) override;
+    Future<ssize_t> sendFile(int fd, off_t offset, size_t len) override;
+
+    size_t bytesReceived() const {
+        return m_readPos;
+    }
+    size_t bytesSent() const {
+        return m_bytesSent;
+    }
+    /** @brief The number of send operations; with the demo protocols, the number of requests handled.
+     * */
+    size_t nrSends() const {
+        return m_nrSends;
+    }
+    /** @brief The FNV-1a hash of all the sent bytes, in order.
+     * */
+    uint64_t checksum() const {
+        return m_checksum;
+    }
+
+private:
+    /** @brief Returns the size of the next chunk, at most len, and advances the read position past it.
+     * */
+    size_t nextChunk(size_t len);
+    void addSent(char const* data, size_t len);
+
+    std::shared_ptr<ReplayCapture const> m_pCapture;
+    size_t const m_maxChunkSize;
+    bool const m_randomChunkSizes;
+    uint32_t m_randomState;
+    size_t m_readPos = 0;
+    size_t m_bytesSent = 0;
+    size_t m_nrSends = 0;
+    uint64_t m_checksum;
+};
@@ -1,9 +1,51 @@
 #include "Socket.h"
 
+#include "BlockingExecutor.h"
+
+#include <errno.h>
+#include <limits.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <sys/un.h>
 #include <string.h>
+#include <thread>
+
+namespace {
+    /** @brief Sends all the data described by iov, retrying after partial writes. Modifies the iov array.
+     * */
+    bool sendAll(int sd, struct iovec* iov, size_t iovCount) {
+        while(iovCount > 0) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovCount < IOV_MAX ? iovCount : IOV_MAX;
+            ssize_t ret = ::sendmsg(sd, &msg, MSG_NOSIGNAL);
+            if(ret < 0) {
+                perror("sendmsg()");
+                return false;
+            }
+            size_t sent = size_t(ret);
+            while(iovCount > 0 && sent >= iov->iov_len) {
+                sent -= iov->iov_len;
+                ++iov;
+                --iovCount;
+            }
+            if(iovCount > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + sent;
+                iov->iov_len -= sent;
+            }
+        }
+        return true;
+    }
+}
 
 Socket::Socket() = default;
 Socket::~Socket() = default;
@@ -11,13 +53,17 @@ Socket::~Socket() = default;
 ServerSocket::ServerSocket() = default;
 ServerSocket::~ServerSocket() = default;
 
-std::unique_ptr<TcpServerSocket> createTcpServer(int port) {
+std::unique_ptr<TcpServerSocket> createTcpServer(int port, int backlog) {
     std::unique_ptr<TcpServerSocket> ret(new TcpServerSocket());
-    ret->m_sd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ret->m_sd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
     if(ret->m_sd < 0) {
         perror("socket()");
         return nullptr;
     }
+    int reuse = 1;
+    if(0 > ::setsockopt(ret->m_sd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse))) {
+        perror("setsockopt(SO_REUSEADDR)");
+    }
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -27,7 +73,7 @@ std::unique_ptr<TcpServerSocket> createTcpServer(int port) {
         perror("bind()");
         return nullptr;
     }
-    if(0 > ::listen(ret->m_sd, 10)) {
+    if(0 > ::listen(ret->m_sd, backlog)) {
         perror("listen()");
         return nullptr;
     }
@@ -35,48 +81,287 @@ std::unique_ptr<TcpServerSocket> createTcpServer(int port) {
     return ret;
 }
 
-TcpServerSocket::~TcpServerSocket() {
-    ::close(m_sd);
+namespace {
+    /** @brief Fills in a UNIX-domain address. Returns false if the path does not fit.
+     * */
+    bool makeUnixAddress(char const* path, struct sockaddr_un* pAddr) {
+        memset(pAddr, 0, sizeof(*pAddr));
+        pAddr->sun_family = AF_UNIX;
+        if(strlen(path) >= sizeof(pAddr->sun_path)) {
+            fprintf(stderr, "UNIX socket path too long: %s\n", path);
+            return false;
+        }
+        strcpy(pAddr->sun_path, path);
+        return true;
+    }
 }
 
-Future<std::shared_ptr<Socket> > TcpServerSocket::accept() {
-    std::shared_ptr<PromiseFuturePair<std::shared_ptr<Socket> > > pf = std::make_shared<PromiseFuturePair<std::shared_ptr<Socket> > >();
-    m_executor.enqueue([this,pf](){
-        int sd = ::accept(m_sd, nullptr, nullptr);
+std::unique_ptr<UnixServerSocket> createUnixServer(char const* path, int backlog) {
+    struct sockaddr_un addr;
+    if(!makeUnixAddress(path, &addr)) {
+        return nullptr;
+    }
+    std::unique_ptr<UnixServerSocket> ret(new UnixServerSocket());
+    ret->m_sd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(ret->m_sd < 0) {
+        perror("socket()");
+        return nullptr;
+    }
+    // A stale socket left by a previous server is removed; any other file makes bind() fail with EADDRINUSE
+    struct stat st;
+    if(0 == ::lstat(path, &st) && S_ISSOCK(st.st_mode)) {
+        ::unlink(path);
+    }
+    if(0 > ::bind(ret->m_sd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+        perror("bind()");
+        return nullptr;
+    }
+    ret->m_path = path;
+    if(0 > ::listen(ret->m_sd, backlog)) {
+        perror("listen()");
+        return nullptr;
+    }
+    
+    return ret;
+}
+
+Future<std::unique_ptr<Socket> > unixConnect(char const* path) {
+    std::shared_ptr<PromiseFuturePair<std::unique_ptr<Socket> > > pf = std::make_shared<PromiseFuturePair<std::unique_ptr<Socket> > >();
+    blockingExecutor().enqueue([pf,strPath=std::string(path)](){
+        struct sockaddr_un addr;
+        if(!makeUnixAddress(strPath.c_str(), &addr)) {
+            pf->set(nullptr);
+            return;
+        }
+        int sd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
         if(sd < 0) {
-            perror("accept()");
+            perror("socket()");
             pf->set(nullptr);
             return;
         }
-        std::shared_ptr<TcpSocket> ps =std::make_shared<TcpSocket>();
-        ps->m_sd = sd;
-        pf->set(std::move(ps));
+        if(0 > ::connect(sd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+            perror("connect()");
+            ::close(sd);
+            pf->set(nullptr);
+            return;
+        }
+        pf->set(std::make_unique<UnixSocket>(sd));
     });
-    return Future<std::shared_ptr<Socket> >(pf);
+    return Future<std::unique_ptr<Socket> >(pf);
+}
+
+Future<std::unique_ptr<Socket> > tcpConnect(char const* hostname, int port) {
+    std::shared_ptr<PromiseFuturePair<std::unique_ptr<Socket> > > pf = std::make_shared<PromiseFuturePair<std::unique_ptr<Socket> > >();
+    blockingExecutor().enqueue([pf,strHostname=std::string(hostname),port](){
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* pResults = nullptr;
+        std::string strPort = std::to_string(port);
+        int err = ::getaddrinfo(strHostname.c_str(), strPort.c_str(), &hints, &pResults);
+        if(err != 0) {
+            fprintf(stderr, "getaddrinfo(): %s\n", gai_strerror(err));
+            pf->set(nullptr);
+            return;
+        }
+        int sd = -1;
+        for(struct addrinfo* p = pResults ; p != nullptr ; p = p->ai_next) {
+            sd = ::socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
+            if(sd < 0) {
+                continue;
+            }
+            if(0 == ::connect(sd, p->ai_addr, p->ai_addrlen)) {
+                break;
+            }
+            ::close(sd);
+            sd = -1;
+        }
+        ::freeaddrinfo(pResults);
+        if(sd < 0) {
+            perror("connect()");
+            pf->set(nullptr);
+            return;
+        }
+        int noDelay = 1;
+        ::setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        pf->set(std::make_unique<TcpSocket>(sd));
+    });
+    return Future<std::unique_ptr<Socket> >(pf);
 }
 
-TcpServerSocket::TcpServerSocket()
+std::pair<std::unique_ptr<Socket>, std::unique_ptr<Socket> > createSocketPair() {
+    int sds[2];
+    if(0 > ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sds)) {
+        perror("socketpair()");
+        return std::make_pair(nullptr, nullptr);
+    }
+    return std::make_pair(std::make_unique<UnixSocket>(sds[0]), std::make_unique<UnixSocket>(sds[1]));
+}
+
+StreamServerSocket::StreamServerSocket()
     :m_sd(-1),
     m_executor(1)
 {
     // empty
 }
 
-TcpSocket::TcpSocket()
-    :m_sd(-1),
-    m_executor(1)
+StreamServerSocket::~StreamServerSocket() {
+    ::close(m_sd);
+}
+
+Future<std::shared_ptr<Socket> > StreamServerSocket::accept() {
+    std::shared_ptr<PromiseFuturePair<std::shared_ptr<Socket> > > pf = std::make_shared<PromiseFuturePair<std::shared_ptr<Socket> > >();
+    m_executor.enqueue([this,pf](){
+        std::vector<std::shared_ptr<Socket> > sockets;
+        acceptPending(sockets, 1);
+        pf->set(sockets.empty() ? nullptr : std::move(sockets.front()));
+    });
+    return Future<std::shared_ptr<Socket> >(pf);
+}
+
+Future<std::vector<std::shared_ptr<Socket> > > StreamServerSocket::acceptBatch(size_t maxCount) {
+    std::shared_ptr<PromiseFuturePair<std::vector<std::shared_ptr<Socket> > > > pf = std::make_shared<PromiseFuturePair<std::vector<std::shared_ptr<Socket> > > >();
+    m_executor.enqueue([this,pf,maxCount](){
+        std::vector<std::shared_ptr<Socket> > sockets;
+        acceptPending(sockets, maxCount == 0 ? 1 : maxCount);
+        pf->set(std::move(sockets));
+    });
+    return Future<std::vector<std::shared_ptr<Socket> > >(pf);
+}
+
+void StreamServerSocket::acceptPending(std::vector<std::shared_ptr<Socket> >& sockets, size_t maxCount) {
+    while(sockets.empty()) {
+        struct pollfd pfd;
+        pfd.fd = m_sd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if(::poll(&pfd, 1, -1) < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            perror("poll()");
+            return;
+        }
+        while(sockets.size() < maxCount) {
+            int sd = ::accept4(m_sd, nullptr, nullptr, SOCK_CLOEXEC);
+            if(sd < 0) {
+                if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break; // backlog drained
+                }
+                if(errno == EINTR || errno == ECONNABORTED || errno == EPROTO) {
+                    continue; // only this connection failed
+                }
+                perror("accept()");
+                return;
+            }
+            std::shared_ptr<StreamSocket> pSocket = createConnection(sd);
+            std::chrono::microseconds busyPollTime = m_busyPollTime.load(std::memory_order_relaxed);
+            if(busyPollTime.count() != 0) {
+                pSocket->setBusyPolling(busyPollTime);
+            }
+            sockets.push_back(std::move(pSocket));
+        }
+    }
+}
+
+void StreamServerSocket::setBusyPolling(std::chrono::microseconds spinTime) {
+    m_busyPollTime.store(spinTime, std::memory_order_relaxed);
+}
+
+TcpServerSocket::TcpServerSocket() = default;
+
+std::shared_ptr<StreamSocket> TcpServerSocket::createConnection(int sd) {
+    return std::make_shared<TcpSocket>(sd);
+}
+
+UnixServerSocket::UnixServerSocket() = default;
+
+UnixServerSocket::~UnixServerSocket() {
+    if(!m_path.empty()) {
+        ::unlink(m_path.c_str());
+    }
+}
+
+std::shared_ptr<StreamSocket> UnixServerSocket::createConnection(int sd) {
+    return std::make_shared<UnixSocket>(sd);
+}
+
+StreamSocket::StreamSocket(int sd)
+    :m_sd(sd),
+    // The thread is started by the first operation, not on the accept path, and retires while the socket is unused
+    m_executor(0, 1)
 {
     // empty
 }
 
-TcpSocket::~TcpSocket()
+StreamSocket::~StreamSocket()
 {
     ::close(m_sd);
 }
 
-Future<ssize_t> TcpSocket::recv(void* data, size_t len) {
+TcpSocket::TcpSocket(int sd)
+    :StreamSocket(sd)
+{
+    // empty
+}
+
+UnixSocket::UnixSocket(int sd)
+    :StreamSocket(sd)
+{
+    // empty
+}
+
+void StreamSocket::setBusyPolling(std::chrono::microseconds spinTime) {
+    m_busyPollTime = spinTime;
+    m_executor.setBusyPolling(spinTime, std::chrono::steady_clock::duration::zero());
+#if defined(SO_BUSY_POLL)
+    // Raising it above net.core.busy_poll needs CAP_NET_ADMIN; the user space polling works without it
+    int busyPollMicroseconds = int(spinTime.count());
+    ::setsockopt(m_sd, SOL_SOCKET, SO_BUSY_POLL, &busyPollMicroseconds, sizeof(busyPollMicroseconds));
+#endif
+}
+
+bool StreamSocket::waitReadable() {
+    struct pollfd pfd;
+    pfd.fd = m_sd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if(m_busyPollTime.count() != 0) {
+        // With a single CPU, the data can only arrive if this thread gives the CPU up between the polls
+        static bool const singleCpu = (std::thread::hardware_concurrency() <= 1);
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + m_busyPollTime;
+        do {
+            int ret = ::poll(&pfd, 1, 0);
+            if(ret > 0) {
+                return true;
+            }
+            if(ret < 0 && errno != EINTR) {
+                perror("poll()");
+                return false;
+            }
+            if(singleCpu) {
+                std::this_thread::yield();
+            }
+        } while(std::chrono::steady_clock::now() < deadline);
+    }
+    while(::poll(&pfd, 1, -1) < 0) {
+        if(errno != EINTR) {
+            perror("poll()");
+            return false;
+        }
+    }
+    return true;
+}
+
+Future<ssize_t> StreamSocket::recv(void* data, size_t len) {
     std::shared_ptr<PromiseFuturePair<ssize_t> > pf = std::make_shared<PromiseFuturePair<ssize_t> >();
     m_executor.enqueue([this,pf,data,len](){
+        // Without busy polling, the blocking recv() is enough
+        if(m_busyPollTime.count() != 0 && !waitReadable()) {
+            pf->set(-1);
+            return;
+        }
         ssize_t ret = ::recv(m_sd, data, len, 0);
         if(ret < 0) {
             perror("recv()");
@@ -86,7 +371,24 @@ Future<ssize_t> TcpSocket::recv(void* data, size_t len) {
     return Future<ssize_t>(pf);
 }
 
-Future<bool> TcpSocket::send(void const* data, size_t len) {
+Future<ssize_t> StreamSocket::recv(BufferPool& pool, BufferSlice* pSlice) {
+    std::shared_ptr<PromiseFuturePair<ssize_t> > pf = std::make_shared<PromiseFuturePair<ssize_t> >();
+    m_executor.enqueue([this,pf,&pool,pSlice](){
+        if(!waitReadable()) {
+            pf->set(-1);
+            return;
+        }
+        *pSlice = pool.allocate();
+        ssize_t ret = ::recv(m_sd, pSlice->data(), pSlice->size(), 0);
+        if(ret < 0) {
+            perror("recv()");
+        }
+        pf->set(ret);
+    });
+    return Future<ssize_t>(pf);
+}
+
+Future<bool> StreamSocket::send(void const* data, size_t len) {
     std::shared_ptr<PromiseFuturePair<bool> > pf = std::make_shared<PromiseFuturePair<bool> >();
     m_executor.enqueue([this,pf,data,len](){
         ssize_t ret = ::send(m_sd, data, len, 0);
@@ -100,7 +402,7 @@ Future<bool> TcpSocket::send(void const* data, size_t len) {
     return Future<bool>(pf);
 }
 
-Future<bool> TcpSocket::send(std::shared_ptr<std::string const> pStr) {
+Future<bool> StreamSocket::send(std::shared_ptr<std::string const> pStr) {
     std::shared_ptr<PromiseFuturePair<bool> > pf = std::make_shared<PromiseFuturePair<bool> >();
     m_executor.enqueue([this,pf,pStr](){
         ssize_t ret = ::send(m_sd, pStr->data(), pStr->size(), 0);
@@ -114,4 +416,52 @@ Future<bool> TcpSocket::send(std::shared_ptr<std::string const> pStr) {
     return Future<bool>(pf);
 }
 
-//Future<std::unique_ptr<Socket> > tcpConnect(char const* hostname, int port);
+Future<bool> StreamSocket::send(BufferSlice slice) {
+    std::shared_ptr<PromiseFuturePair<bool> > pf = std::make_shared<PromiseFuturePair<bool> >();
+    m_executor.enqueue([this,pf,tmpSlice=std::move(slice)](){
+        struct iovec iov;
+        iov.iov_base = tmpSlice.data();
+        iov.iov_len = tmpSlice.size();
+        pf->set(sendAll(m_sd, &iov, 1));
+    });
+    return Future<bool>(pf);
+}
+
+Future<bool> StreamSocket::send(std::vector<BufferSlice> slices) {
+    std::shared_ptr<PromiseFuturePair<bool> > pf = std::make_shared<PromiseFuturePair<bool> >();
+    m_executor.enqueue([this,pf,tmpSlices=std::move(slices)](){
+        std::vector<struct iovec> iov(tmpSlices.size());
+        for(size_t i = 0 ; i < tmpSlices.size() ; ++i) {
+            iov[i].iov_base = tmpSlices[i].data();
+            iov[i].iov_len = tmpSlices[i].size();
+        }
+        pf->set(sendAll(m_sd, iov.data(), iov.size()));
+    });
+    return Future<bool>(pf);
+}
+
+Future<ssize_t> StreamSocket::sendFile(int fd, off_t offset, size_t len) {
+    std::shared_ptr<PromiseFuturePair<ssize_t> > pf = std::make_shared<PromiseFuturePair<ssize_t> >();
+    m_executor.enqueue([this,pf,fd,offset,len](){
+        off_t pos = offset;
+        size_t sent = 0;
+        while(sent < len) {
+            ssize_t ret = ::sendfile(m_sd, fd, &pos, len - sent);
+            if(ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if(ret < 0) {
+                perror("sendfile()");
+                pf->set(-1);
+                return;
+            }
+            if(ret == 0) {
+                break; // end of file
+            }
+            sent += size_t(ret);
+        }
+        pf->set(ssize_t(sent));
+    });
+    return Future<ssize_t>(pf);
+}
+
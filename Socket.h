@@ -1,8 +1,16 @@
 #pragma once
 
+#include "BufferPool.h"
 #include "Future.h"
 #include "ThreadPool.h"
 
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
 /** A connection socket offering asynchronous operations.
  * 
  * @note This implementation is mostly for demo purposes. A better implementation would use poll() or select()
@@ -23,6 +31,15 @@ public:
      * @return a future that will receive the number of bytes actually read, 0 on end-of-file, or a negative number on error
      */
     virtual Future<ssize_t> recv(void* data, size_t len) = 0;
+
+    /**
+     * @brief Launches a receive into a buffer taken from a pool. The buffer is taken only when data is available, so that
+     * a connection waiting for data does not hold one.
+     * @param pool the pool to take the buffer from
+     * @param pSlice where the buffer is to be stored; the received data is at its beginning
+     * @return the same as recv(void*, size_t)
+     */
+    virtual Future<ssize_t> recv(BufferPool& pool, BufferSlice* pSlice) = 0;
     
     /**
      * @brief Launches sending data to the socket
@@ -32,6 +49,23 @@ public:
      */
     virtual Future<bool> send(void const* data, size_t len) = 0;
     virtual Future<bool> send(std::shared_ptr<std::string const> pStr) = 0;
+
+    /** @brief Launches sending the data in the slice; the slice is kept alive, without copying the data, until sending completes.
+     * */
+    virtual Future<bool> send(BufferSlice slice) = 0;
+
+    /** @brief Launches sending the data in all the slices, in order, as a single gathered write.
+     * */
+    virtual Future<bool> send(std::vector<BufferSlice> slices) = 0;
+
+    /**
+     * @brief Launches sending a range of a file to the socket, without copying it through user space where possible
+     * @param fd an open file descriptor (for instance, AsyncFile::fd()); it must stay open until the future completes
+     * @param offset the position in the file where the range starts
+     * @param len the length of the range
+     * @return a future that will receive the number of bytes sent (less than len if the file ends before), or a negative number on error
+     */
+    virtual Future<ssize_t> sendFile(int fd, off_t offset, size_t len) = 0;
 };
 
 /** A server TCP listening socket offering asynchronous operations.
@@ -51,49 +85,142 @@ public:
     /** Starts waiting for a new connection from a client. Returns a future that will complete when a connection is accepted.
      * */
     virtual Future<std::shared_ptr<Socket> > accept() = 0;
+
+    /** Starts waiting for new connections. Returns a future that will complete, as soon as at least one connection is accepted,
+     * with all the pending connections (at most maxCount), or with no connection on error.
+     * */
+    virtual Future<std::vector<std::shared_ptr<Socket> > > acceptBatch(size_t maxCount) = 0;
 };
 
 
 class TcpSocket;
 class TcpServerSocket;
+class UnixServerSocket;
 
-std::unique_ptr<TcpServerSocket> createTcpServer(int port);
+/** @brief Creates a server listening on a TCP port, on all interfaces.
+ * @param backlog the maximum number of connections waiting to be accepted; the system may cap it (see /proc/sys/net/core/somaxconn)
+ * */
+std::unique_ptr<TcpServerSocket> createTcpServer(int port, int backlog = SOMAXCONN);
 
 /** @brief Asynchronously connects to a remote server. Returns a future that will complete when the connection is established.
  * */
 Future<std::unique_ptr<Socket> > tcpConnect(char const* hostname, int port);
 
-class TcpSocket : public Socket {
+/** @brief Creates a server listening on a UNIX-domain stream socket bound to the given path. An existing socket at that path
+ * (typically left by a previous server) is removed; any other existing file makes the creation fail.
+ * */
+std::unique_ptr<UnixServerSocket> createUnixServer(char const* path, int backlog = SOMAXCONN);
+
+/** @brief Asynchronously connects to a UNIX-domain stream socket. Returns a future that will complete when the connection is established.
+ * */
+Future<std::unique_ptr<Socket> > unixConnect(char const* path);
+
+/** @brief Creates a pair of connected sockets (socketpair()), for communication within the process or with a child process.
+ * Returns a pair of null pointers on failure.
+ * */
+std::pair<std::unique_ptr<Socket>, std::unique_ptr<Socket> > createSocketPair();
+
+/** A connected stream socket: TCP, UNIX-domain, or one end of a socket pair. The operations are executed as blocking calls
+ * on a thread belonging to the socket; the thread is started when needed.
+ * */
+class StreamSocket : public Socket {
 public:
-    ~TcpSocket() override;
+    ~StreamSocket() override;
 
     Future<ssize_t> recv(void* data, size_t len) override;
     
+    Future<ssize_t> recv(BufferPool& pool, BufferSlice* pSlice) override;
+    
     Future<bool> send(void const* data, size_t len) override;
     Future<bool> send(std::shared_ptr<std::string const> pStr) override;
+    Future<bool> send(BufferSlice slice) override;
+    Future<bool> send(std::vector<BufferSlice> slices) override;
+    Future<ssize_t> sendFile(int fd, off_t offset, size_t len) override;
+
+    /** @brief Makes the socket wait for data by polling without blocking, for up to spinTime, before blocking in the kernel;
+     * the thread of the socket also spins for that long, waiting for the next operation, before it sleeps. SO_BUSY_POLL is
+     * set too, where the system allows it, so that the kernel polls the device queue. It costs a core per busy socket;
+     * to be called before starting any operation.
+     * */
+    void setBusyPolling(std::chrono::microseconds spinTime);
 
-    TcpSocket();
+protected:
+    /** @brief Takes ownership of an already connected socket descriptor.
+     * */
+    explicit StreamSocket(int sd);
 
-private:
-    friend Future<std::unique_ptr<Socket> > tcpConnect(char const* hostname, int port);
-    friend class TcpServerSocket;
+    /** @brief Waits until the socket is readable, busy polling first if enabled. Returns false on error.
+     * */
+    bool waitReadable();
 
-    
     int m_sd;
     ThreadPool m_executor;
+    std::chrono::microseconds m_busyPollTime{0};
 };
 
-class TcpServerSocket : public ServerSocket {
+class TcpSocket : public StreamSocket {
 public:
-    ~TcpServerSocket() override;
+    explicit TcpSocket(int sd);
+};
+
+class UnixSocket : public StreamSocket {
+public:
+    explicit UnixSocket(int sd);
+};
+
+/** A server socket listening for stream connections.
+ *
+ * The listening socket is non-blocking. Accepting waits with poll() on a thread belonging to the socket, then drains the
+ * backlog with accept4() until it would block, so that a burst of connections costs a single task and a single future.
+ * */
+class StreamServerSocket : public ServerSocket {
+public:
+    ~StreamServerSocket() override;
     
     Future<std::shared_ptr<Socket> > accept() override;
+    Future<std::vector<std::shared_ptr<Socket> > > acceptBatch(size_t maxCount) override;
 
-private:
-    friend std::unique_ptr<TcpServerSocket> createTcpServer(int port);
+    /** @brief Enables busy polling (see StreamSocket::setBusyPolling()) on the connections accepted from now on.
+     * */
+    void setBusyPolling(std::chrono::microseconds spinTime);
 
-    TcpServerSocket();
+protected:
+    StreamServerSocket();
+
+    /** @brief Waits for connections, then accepts up to maxCount of them without blocking. Leaves sockets empty on error.
+     * */
+    void acceptPending(std::vector<std::shared_ptr<Socket> >& sockets, size_t maxCount);
+
+    /** @brief Creates the Socket object for an accepted connection.
+     * */
+    virtual std::shared_ptr<StreamSocket> createConnection(int sd) = 0;
     
     int m_sd;
     ThreadPool m_executor;
+    std::atomic<std::chrono::microseconds> m_busyPollTime{std::chrono::microseconds(0)};
+};
+
+class TcpServerSocket : public StreamServerSocket {
+protected:
+    std::shared_ptr<StreamSocket> createConnection(int sd) override;
+
+private:
+    friend std::unique_ptr<TcpServerSocket> createTcpServer(int port, int backlog);
+
+    TcpServerSocket();
+};
+
+class UnixServerSocket : public StreamServerSocket {
+public:
+    ~UnixServerSocket() override;
+
+protected:
+    std::shared_ptr<StreamSocket> createConnection(int sd) override;
+
+private:
+    friend std::unique_ptr<UnixServerSocket> createUnixServer(char const* path, int backlog);
+
+    UnixServerSocket();
+
+    std::string m_path;
 };
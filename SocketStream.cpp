@@ -0,0 +1,117 @@
+#include "SocketStream.h"
+
+#include "Continuations.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    /** @brief The number of chunks taken from the byte stream at once, by the parser.
+     * */
+    size_t const chunkBatchSize = 16;
+
+    struct SocketReadData {
+        SocketReadData(std::shared_ptr<Socket> pSocket_, BufferPool* pPool_, AsyncStream<BufferSlice> stream_)
+            :pSocket(std::move(pSocket_)),
+            pPool(pPool_),
+            stream(std::move(stream_))
+            {}
+
+        std::shared_ptr<Socket> pSocket;
+        BufferPool* pPool;
+        AsyncStream<BufferSlice> stream;
+        BufferSlice slice;
+    };
+
+    struct ParseIntData {
+        ParseIntData(AsyncStream<BufferSlice> bytes_, AsyncStream<int> ints_)
+            :bytes(std::move(bytes_)),
+            ints(std::move(ints_))
+            {}
+
+        AsyncStream<BufferSlice> bytes;
+        AsyncStream<int> ints;
+        int tmpVal = 0;
+        bool readingNumber = false;
+    };
+}
+
+AsyncStream<BufferSlice> socketByteStream(Executor& executor, std::shared_ptr<Socket> pSocket, BufferPool& pool, size_t capacity) {
+    AsyncStream<BufferSlice> stream(capacity);
+    std::shared_ptr<SocketReadData> pData = std::make_shared<SocketReadData>(std::move(pSocket), &pool, stream);
+    Future<bool> loopResult = executeAsyncLoop<bool>(executor,
+        [](bool cont){return cont;},
+        [&executor,pData](bool)->Future<bool> {
+            return addAsyncContinuation<bool>(executor, [pData](ssize_t received)->Future<bool> {
+                if(received < 0) {
+                    pData->stream.fail(std::make_exception_ptr(std::runtime_error("recv() failed")));
+                    return completedFuture(false);
+                }
+                if(received == 0) {
+                    pData->stream.close();
+                    return completedFuture(false);
+                }
+                BufferSlice chunk = pData->slice.subSlice(0, size_t(received));
+                // Do not hold the slab while waiting for more data
+                pData->slice.reset();
+                return pData->stream.push(std::move(chunk));
+            }, pData->pSocket->recv(*pData->pPool, &pData->slice));
+        },
+        true);
+    loopResult.addCallback([stream](Future<bool>::FutureValueType const& val) mutable {
+        if(std::holds_alternative<std::exception_ptr>(val)) {
+            stream.fail(std::get<std::exception_ptr>(val));
+        }
+    });
+    return stream;
+}
+
+AsyncStream<int> parseIntStream(Executor& executor, AsyncStream<BufferSlice> bytes, size_t capacity) {
+    AsyncStream<int> ints(capacity);
+    std::shared_ptr<ParseIntData> pData = std::make_shared<ParseIntData>(std::move(bytes), ints);
+    Future<bool> loopResult = executeAsyncLoop<bool>(executor,
+        [](bool cont){return cont;},
+        [&executor,pData](bool)->Future<bool> {
+            return addAsyncContinuation<bool>(executor, [pData](std::vector<BufferSlice> chunks)->Future<bool> {
+                if(chunks.empty()) {
+                    if(pData->readingNumber) {
+                        pData->ints.push(pData->tmpVal);
+                    }
+                    pData->ints.close();
+                    return completedFuture(false);
+                }
+                std::vector<int> values;
+                for(BufferSlice const& chunk : chunks) {
+                    for(char const* p = chunk.data() ; p != chunk.data() + chunk.size() ; ++p) {
+                        char c = *p;
+                        if(c >= '0' && c <= '9') {
+                            pData->readingNumber = true;
+                            pData->tmpVal = 10*pData->tmpVal + (c-'0');
+                        } else if(c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                            if(pData->readingNumber) {
+                                values.push_back(pData->tmpVal);
+                                pData->readingNumber = false;
+                                pData->tmpVal = 0;
+                            }
+                        } else {
+                            pData->ints.fail(std::make_exception_ptr(std::runtime_error("invalid character in integer stream")));
+                            return completedFuture(false);
+                        }
+                    }
+                }
+                if(values.empty()) {
+                    return completedFuture(true);
+                }
+                return pData->ints.pushBatch(std::move(values));
+            }, pData->bytes.nextBatch(chunkBatchSize));
+        },
+        true);
+    loopResult.addCallback([pData](Future<bool>::FutureValueType const& val) {
+        if(std::holds_alternative<std::exception_ptr>(val)) {
+            pData->ints.fail(std::get<std::exception_ptr>(val));
+        }
+        // Stops the producer of the input, if the parsing ended before it
+        pData->bytes.cancel();
+    });
+    return ints;
+}
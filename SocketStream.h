@@ -0,0 +1,32 @@
+#pragma once
+
+#include "AsyncStream.h"
+#include "BufferPool.h"
+#include "Executor.h"
+#include "Socket.h"
+
+#include <memory>
+
+/**
+ * @brief Turns the data received from a socket into a stream of chunks of bytes
+ * @param executor the executor where the receive loop continuations are to be executed
+ * @param pSocket the socket to read from; it is kept alive until the receive loop ends
+ * @param pool the pool where the receive buffers are taken from; each chunk is a slice of one of its slabs
+ * @param capacity the maximum number of chunks buffered before receiving is suspended
+ * @return a stream that ends when the other end closes the connection, or fails with std::runtime_error on a receive error
+ *
+ * If the consumer cancels the stream, the loop stops after the receive that is already in progress completes.
+ */
+AsyncStream<BufferSlice> socketByteStream(Executor& executor, std::shared_ptr<Socket> pSocket, BufferPool& pool, size_t capacity = 16);
+
+/**
+ * @brief Parses a stream of chunks of bytes into a stream of integers
+ * @param executor the executor where the parsing is to be executed
+ * @param bytes the input; it contains non-negative decimal integers separated by whitespace
+ * @param capacity the maximum number of integers buffered before parsing is suspended
+ * @return a stream that fails with std::runtime_error on any other character, and with any error of the input stream
+ *
+ * The input chunks are taken in batches, and all the integers parsed from a batch are pushed with a single pushBatch(),
+ * so the cost per integer is only that of parsing it.
+ */
+AsyncStream<int> parseIntStream(Executor& executor, AsyncStream<BufferSlice> bytes, size_t capacity = 4096);
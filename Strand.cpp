@@ -0,0 +1,100 @@
+#include "Strand.h"
+
+#include <thread>
+
+namespace {
+    /** @brief Maximum number of tasks a drain runs before yielding the thread back to the underlying executor.
+     * */
+    size_t const maxTasksPerDrain = 64;
+}
+
+/** @brief Multi-producer, single-consumer queue (D. Vyukov's algorithm), plus the count of queued tasks.
+ * */
+class Strand::State {
+public:
+    explicit State(Executor& executor)
+        :m_executor(executor),
+        m_head(new Node),
+        m_tail(m_head.load(std::memory_order_relaxed))
+        {}
+    ~State() {
+        while(m_tail != nullptr) {
+            Node* next = m_tail->next.load(std::memory_order_relaxed);
+            delete m_tail;
+            m_tail = next;
+        }
+    }
+
+    /** @brief Adds a task; returns true if the strand was empty, so a drain must be scheduled.
+     * */
+    bool push(std::function<void()> func) {
+        Node* node = new Node;
+        node->func = std::move(func);
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+        return m_nrPending.fetch_add(1, std::memory_order_acq_rel) == 0;
+    }
+
+    /** @brief Removes the oldest task. Must be called only by the drain, and only when a task is known to be pending.
+     * */
+    std::function<void()> pop() {
+        Node* next = m_tail->next.load(std::memory_order_acquire);
+        while(next == nullptr) {
+            // A producer has swapped the head but has not linked its node yet
+            std::this_thread::yield();
+            next = m_tail->next.load(std::memory_order_acquire);
+        }
+        std::function<void()> func = std::move(next->func);
+        delete m_tail;
+        m_tail = next;
+        return func;
+    }
+
+    /** @brief Marks a task as done; returns true if more tasks are pending.
+     * */
+    bool finishOne() {
+        return m_nrPending.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    Executor& executor() {
+        return m_executor;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::function<void()> func;
+    };
+
+    Executor& m_executor;
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+    std::atomic<size_t> m_nrPending{0};
+};
+
+Strand::Strand(Executor& executor)
+    :m_pState(std::make_shared<State>(executor))
+{
+}
+
+Strand::~Strand() = default;
+
+void Strand::enqueue(std::function<void()> func) {
+    if(m_pState->push(std::move(func))) {
+        m_pState->executor().enqueue([pState=m_pState](){drain(pState);});
+    }
+}
+
+void Strand::drain(std::shared_ptr<State> pState) {
+    for(size_t i = 0 ; i < maxTasksPerDrain ; ++i) {
+        {
+            std::function<void()> func = pState->pop();
+            func();
+        }
+        if(!pState->finishOne()) {
+            return;
+        }
+    }
+    // Let other work of the underlying executor run before continuing with this strand
+    pState->executor().enqueue([pState](){drain(pState);});
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Executor.h"
+
+#include <atomic>
+#include <memory>
+
+/** @brief Executor adaptor that runs the enqueued tasks one at a time, in the order they were enqueued, on top of
+ * another (possibly multi-threaded) executor.
+ *
+ * Tasks are pushed on a lock-free queue; the first task that makes the strand non-empty schedules a drain task on
+ * the underlying executor, which runs queued tasks until the strand becomes empty again. Thus, no lock is taken and
+ * no task runs concurrently with another task of the same strand, while different strands share the same threads.
+ *
+ * The Strand object may be destroyed while tasks are still queued; they will still be executed.
+ * */
+class Strand : public Executor {
+public:
+    explicit Strand(Executor& executor);
+    Strand(Strand const&) = delete;
+    Strand(Strand&&) = delete;
+    Strand& operator=(Strand const&) = delete;
+    Strand& operator=(Strand&&) = delete;
+    ~Strand() override;
+
+    void enqueue(std::function<void()> func) override;
+
+private:
+    class State;
+
+    static void drain(std::shared_ptr<State> pState);
+
+    std::shared_ptr<State> m_pState;
+};
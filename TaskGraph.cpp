@@ -0,0 +1,171 @@
+#include "TaskGraph.h"
+
+#include <atomic>
+#include <stdexcept>
+
+/** @brief The immutable form of a graph, shared by its runs: the successors of all nodes in a single array, and the nodes
+ * without dependencies.
+ * */
+class TaskGraph::Plan {
+public:
+    explicit Plan(std::vector<Node> const& nodes)
+        :m_funcs(nodes.size()),
+        m_nrDependencies(nodes.size()),
+        m_firstSuccessor(nodes.size() + 1, 0)
+    {
+        for(NodeId id = 0 ; id < nodes.size() ; ++id) {
+            m_funcs[id] = nodes[id].func;
+            m_nrDependencies[id] = nodes[id].nrDependencies;
+            m_firstSuccessor[id + 1] = m_firstSuccessor[id] + nodes[id].successors.size();
+            m_successors.insert(m_successors.end(), nodes[id].successors.begin(), nodes[id].successors.end());
+            if(nodes[id].nrDependencies == 0) {
+                m_roots.push_back(id);
+            }
+        }
+        m_acyclic = checkAcyclic();
+    }
+
+    size_t nrNodes() const {
+        return m_funcs.size();
+    }
+    bool isAcyclic() const {
+        return m_acyclic;
+    }
+
+    std::vector<std::function<void()> > m_funcs;
+    std::vector<size_t> m_nrDependencies;
+    /** The successors of node i are m_successors[m_firstSuccessor[i]] to m_successors[m_firstSuccessor[i+1]-1] */
+    std::vector<size_t> m_firstSuccessor;
+    std::vector<NodeId> m_successors;
+    std::vector<NodeId> m_roots;
+
+private:
+    /** @brief Kahn's algorithm: the graph is acyclic if removing the nodes without remaining dependencies removes all of them.
+     * */
+    bool checkAcyclic() const {
+        std::vector<size_t> nrRemaining(m_nrDependencies);
+        std::vector<NodeId> ready(m_roots);
+        size_t nrVisited = 0;
+        while(!ready.empty()) {
+            NodeId id = ready.back();
+            ready.pop_back();
+            ++nrVisited;
+            for(size_t i = m_firstSuccessor[id] ; i < m_firstSuccessor[id + 1] ; ++i) {
+                if(--nrRemaining[m_successors[i]] == 0) {
+                    ready.push_back(m_successors[i]);
+                }
+            }
+        }
+        return nrVisited == nrNodes();
+    }
+
+    bool m_acyclic;
+};
+
+/** @brief The state of one run of a graph.
+ * */
+class TaskGraph::Run {
+public:
+    Run(Executor& executor, std::shared_ptr<Plan const> pPlan)
+        :m_executor(executor),
+        m_pPlan(std::move(pPlan)),
+        m_nrDependencies(new std::atomic<size_t>[m_pPlan->nrNodes()]),
+        m_nrRemaining(m_pPlan->nrNodes()),
+        m_pDone(std::make_shared<PromiseFuturePair<void> >())
+    {
+        for(NodeId id = 0 ; id < m_pPlan->nrNodes() ; ++id) {
+            m_nrDependencies[id].store(m_pPlan->m_nrDependencies[id], std::memory_order_relaxed);
+        }
+    }
+
+    /** @brief Hands the nodes without dependencies to the executor.
+     * */
+    static Future<void> start(std::shared_ptr<Run> pThis) {
+        Future<void> ret(pThis->m_pDone);
+        for(NodeId id : pThis->m_pPlan->m_roots) {
+            pThis->m_executor.enqueue([pThis,id](){execute(pThis, id);});
+        }
+        return ret;
+    }
+
+private:
+    static NodeId const noNode = NodeId(-1);
+
+    /** @brief Runs a node, then the nodes it makes ready: all but one are handed to the executor, and the last one runs
+     * on this thread, in a loop rather than recursively.
+     * */
+    static void execute(std::shared_ptr<Run> const& pThis, NodeId id) {
+        Plan const& plan = *pThis->m_pPlan;
+        while(id != noNode) {
+            if(!pThis->m_failed.load(std::memory_order_relaxed)) {
+                try {
+                    plan.m_funcs[id]();
+                } catch(...) {
+                    if(!pThis->m_failed.exchange(true)) {
+                        pThis->m_pEx = std::current_exception();
+                    }
+                }
+            }
+            NodeId next = noNode;
+            for(size_t i = plan.m_firstSuccessor[id] ; i < plan.m_firstSuccessor[id + 1] ; ++i) {
+                NodeId successor = plan.m_successors[i];
+                if(pThis->m_nrDependencies[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if(next != noNode) {
+                        pThis->m_executor.enqueue([pThis,next](){execute(pThis, next);});
+                    }
+                    next = successor;
+                }
+            }
+            if(pThis->m_nrRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if(pThis->m_pEx) {
+                    pThis->m_pDone->setException(pThis->m_pEx);
+                } else {
+                    pThis->m_pDone->set();
+                }
+            }
+            id = next;
+        }
+    }
+
+    Executor& m_executor;
+    std::shared_ptr<Plan const> m_pPlan;
+    std::unique_ptr<std::atomic<size_t>[]> m_nrDependencies;
+    std::atomic<size_t> m_nrRemaining;
+    std::atomic<bool> m_failed{false};
+    std::exception_ptr m_pEx;
+    std::shared_ptr<PromiseFuturePair<void> > m_pDone;
+};
+
+TaskGraph::TaskGraph() = default;
+TaskGraph::~TaskGraph() = default;
+
+TaskGraph::NodeId TaskGraph::addNode(std::function<void()> func) {
+    m_pPlan = nullptr;
+    m_nodes.emplace_back();
+    m_nodes.back().func = std::move(func);
+    return m_nodes.size() - 1;
+}
+
+void TaskGraph::addDependency(NodeId before, NodeId after) {
+    if(before >= m_nodes.size() || after >= m_nodes.size()) {
+        throw std::out_of_range("TaskGraph::addDependency(): no such node");
+    }
+    m_pPlan = nullptr;
+    m_nodes[before].successors.push_back(after);
+    ++m_nodes[after].nrDependencies;
+}
+
+Future<void> TaskGraph::run(Executor& executor) {
+    if(m_nodes.empty()) {
+        return completedFuture();
+    }
+    if(m_pPlan == nullptr) {
+        m_pPlan = std::make_shared<Plan>(m_nodes);
+    }
+    if(!m_pPlan->isAcyclic()) {
+        std::shared_ptr<PromiseFuturePair<void> > ret = std::make_shared<PromiseFuturePair<void> >();
+        ret->setException(std::make_exception_ptr(std::logic_error("TaskGraph::run(): the dependencies form a cycle")));
+        return Future<void>(ret);
+    }
+    return Run::start(std::make_shared<Run>(executor, m_pPlan));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Executor.h"
+#include "Future.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/** @brief A directed acyclic graph of tasks, declared once and run any number of times, on any executor.
+ *
+ * Each node is a function; a dependency makes a node wait until another one has completed. Running the graph costs one
+ * allocation for the run, one atomic counter per node, and one PromiseFuturePair for the whole graph, instead of a future
+ * and a callback for each edge, as with chained continuations. A node is handed to the executor as soon as the last of
+ * its dependencies completes; when a node makes several others ready, the last of them runs directly on the same thread.
+ *
+ * If a node throws, the nodes that have not started yet are skipped, and the run completes with the first exception.
+ *
+ * The graph must not be modified while it is being run, but it may be destroyed: each run keeps what it needs. Several
+ * runs of the same graph may be in progress at the same time, in which case the functions are called concurrently.
+ * */
+class TaskGraph {
+public:
+    using NodeId = size_t;
+
+    TaskGraph();
+    TaskGraph(TaskGraph const&) = delete;
+    TaskGraph(TaskGraph&&) = delete;
+    TaskGraph& operator=(TaskGraph const&) = delete;
+    TaskGraph& operator=(TaskGraph&&) = delete;
+    ~TaskGraph();
+
+    /** @brief Adds a node, with no dependencies yet. Returns its id, to be used with addDependency().
+     * */
+    NodeId addNode(std::function<void()> func);
+
+    /** @brief Makes the node "after" wait until the node "before" has completed.
+     * */
+    void addDependency(NodeId before, NodeId after);
+
+    size_t nrNodes() const {
+        return m_nodes.size();
+    }
+
+    /**
+     * @brief Runs all the nodes, respecting the dependencies
+     * @param executor The executor on which the nodes run
+     * @return A future that completes when all nodes complete, or with the first exception thrown by a node; it completes
+     * with a std::logic_error if the dependencies form a cycle
+     */
+    Future<void> run(Executor& executor);
+
+private:
+    struct Node {
+        std::function<void()> func;
+        std::vector<NodeId> successors;
+        size_t nrDependencies = 0;
+    };
+    class Plan;
+    class Run;
+
+    std::vector<Node> m_nodes;
+    /** The graph in the form used by the runs; built by the first run after a modification. */
+    std::shared_ptr<Plan const> m_pPlan;
+};
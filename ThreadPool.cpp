@@ -1,10 +1,44 @@
 #include "ThreadPool.h"
 
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    /** @brief Tells the CPU that the thread is spinning, so that it saves power and yields to the other hyper-thread.
+     * */
+    inline void cpuRelax() {
+#if defined(__SSE2__)
+        _mm_pause();
+#endif
+    }
+}
+
+thread_local ThreadPool::WorkerSlot* ThreadPool::s_pCurrentSlot = nullptr;
+
 ThreadPool::ThreadPool(size_t nrThreads)
+    :ThreadPool(nrThreads, nrThreads)
+{
+}
+
+ThreadPool::ThreadPool(size_t minThreads, size_t maxThreads,
+        std::chrono::steady_clock::duration maxQueueDelay,
+        std::chrono::steady_clock::duration idleTimeout,
+        bool useWorkerSlots)
+    :m_minThreads(minThreads),
+    m_maxThreads(maxThreads < minThreads ? minThreads : maxThreads),
+    m_maxQueueDelay(maxQueueDelay),
+    m_idleTimeout(idleTimeout),
+    m_useWorkerSlots(useWorkerSlots)
 {
-    m_workers.reserve(nrThreads);
-    for (size_t i = 0; i < nrThreads; ++i) {
-        m_workers.emplace_back(&ThreadPool::workerFunction, this);
+    std::unique_lock<std::mutex> lck(m_mutex);
+    for (size_t i = 0; i < m_minThreads; ++i) {
+        startWorker();
+    }
+    if (m_minThreads != m_maxThreads) {
+        m_monitor = std::thread(&ThreadPool::monitorFunction, this);
     }
 }
 
@@ -12,31 +46,239 @@ ThreadPool::~ThreadPool() {
     std::unique_lock<std::mutex> lck(m_mutex);
     m_closing = true;
     m_cv.notify_all();
+    m_monitorCv.notify_one();
     lck.unlock();
+    if (m_monitor.joinable()) {
+        m_monitor.join();
+    }
+    // Once m_closing is set, workers neither retire nor get started, so the lists are stable
     for (auto& worker : m_workers) {
+        worker.thread.join();
+    }
+    for (auto& worker : m_retiredWorkers) {
         worker.join();
     }
 }
 
 void ThreadPool::enqueue(std::function<void()> func) {
+    WorkerSlot* pSlot = s_pCurrentSlot;
+    // When another worker could run the task right away, the slot would only delay it
+    if (m_useWorkerSlots && pSlot != nullptr && pSlot->pPool == this && m_nrIdle.load() == 0
+            && m_nrWorkers.load(std::memory_order_relaxed) >= m_maxThreads) {
+        // The newest task takes the slot; the one it displaces, if any, goes to the shared queue
+        {
+            std::unique_lock<std::mutex> slotLck(pSlot->mutex);
+            std::swap(func, pSlot->next);
+        }
+        if (!func) {
+            ++m_nrSlotted;
+            // A worker that became idle meanwhile may have looked at the slots before this task was put there; it is
+            // handed over through the shared queue instead. Both counters are sequentially consistent, so either the
+            // idle worker sees m_nrSlotted, or this thread sees m_nrIdle.
+            if (m_nrIdle.load() == 0) {
+                return;
+            }
+            func = takeSlotTask(*pSlot);
+            if (!func) {
+                return;
+            }
+        }
+    }
     std::unique_lock<std::mutex> lck(m_mutex);
-    m_workItems.push(std::move(func));
+    pushWorkItem(std::move(func));
     m_cv.notify_one();
 }
 
-void ThreadPool::workerFunction() {
+void ThreadPool::pushWorkItem(std::function<void()> func) {
+    if (m_minThreads == m_maxThreads) {
+        m_workItems.push(WorkItem{std::move(func), std::chrono::steady_clock::time_point()});
+    } else {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        m_workItems.push(WorkItem{std::move(func), now});
+        growIfNeeded(now);
+        if (m_monitorSleeping) {
+            m_monitorCv.notify_one();
+        }
+    }
+    m_nrWorkItems.store(m_workItems.size(), std::memory_order_relaxed);
+}
+
+size_t ThreadPool::concurrency() const {
+    return m_maxThreads;
+}
+
+size_t ThreadPool::nrThreads() const {
+    std::unique_lock<std::mutex> lck(m_mutex);
+    return m_workers.size();
+}
+
+void ThreadPool::setBusyPolling(std::chrono::steady_clock::duration spinTime, std::chrono::steady_clock::duration yieldTime) {
     std::unique_lock<std::mutex> lck(m_mutex);
+    m_spinTime = spinTime;
+    m_yieldTime = yieldTime;
+}
+
+void ThreadPool::pollForWork(std::chrono::steady_clock::duration spinTime, std::chrono::steady_clock::duration yieldTime) const {
+    // With a single CPU, the task can only be enqueued by another thread if this one gives the CPU up
+    static bool const singleCpu = (std::thread::hardware_concurrency() <= 1);
+    if (singleCpu) {
+        yieldTime += spinTime;
+        spinTime = std::chrono::steady_clock::duration::zero();
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (m_nrWorkItems.load(std::memory_order_relaxed) == 0) {
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed >= spinTime + yieldTime) {
+            return;
+        }
+        if (elapsed < spinTime) {
+            // Reading the clock costs more than checking the queue, so it is read only every few checks
+            for (int i = 0; i < 64 && m_nrWorkItems.load(std::memory_order_relaxed) == 0; ++i) {
+                cpuRelax();
+            }
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ThreadPool::growIfNeeded(std::chrono::steady_clock::time_point now) {
+    if (m_nrIdle != 0 || m_closing || m_workers.size() >= m_maxThreads || m_workItems.empty()) {
+        return;
+    }
+    if (m_workers.empty() || now - m_workItems.front().enqueueTime >= m_maxQueueDelay) {
+        startWorker();
+    }
+}
+
+void ThreadPool::startWorker() {
+    // Retired workers have already released the lock and are just exiting, so joining them here is quick
+    for (auto& worker : m_retiredWorkers) {
+        worker.join();
+    }
+    m_retiredWorkers.clear();
+    WorkerList::iterator it = m_workers.emplace(m_workers.end());
+    it->slot.pPool = this;
+    // Until it takes the lock, the new worker counts as idle, so that it is not started again for the same task
+    ++m_nrIdle;
+    it->thread = std::thread(&ThreadPool::workerFunction, this, it);
+    m_nrWorkers.store(m_workers.size(), std::memory_order_relaxed);
+}
+
+void ThreadPool::monitorFunction() {
+    std::unique_lock<std::mutex> lck(m_mutex);
+    while (!m_closing) {
+        if (m_workItems.empty() || m_workers.size() >= m_maxThreads) {
+            m_monitorSleeping = true;
+            m_monitorCv.wait(lck);
+            m_monitorSleeping = false;
+            continue;
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        growIfNeeded(now);
+        // Checks again when the oldest task reaches the delay. If it already has, a worker is idle or being started, and
+        // is expected to dequeue it soon.
+        std::chrono::steady_clock::time_point deadline = now + std::max<std::chrono::steady_clock::duration>(m_maxQueueDelay, minMonitorPeriod);
+        if (!m_workItems.empty() && m_workItems.front().enqueueTime + m_maxQueueDelay > now) {
+            deadline = m_workItems.front().enqueueTime + m_maxQueueDelay;
+        }
+        m_monitorCv.wait_until(lck, deadline);
+    }
+}
+
+void ThreadPool::runSlot(WorkerSlot& slot) {
+    for (unsigned nrRuns = 0; nrRuns < maxConsecutiveSlotRuns; ++nrRuns) {
+        std::function<void()> func = takeSlotTask(slot);
+        if (!func) {
+            return;
+        }
+        func();
+    }
+}
+
+std::function<void()> ThreadPool::takeSlotTask(WorkerSlot& slot) {
+    std::function<void()> func;
+    std::unique_lock<std::mutex> slotLck(slot.mutex);
+    if (slot.next) {
+        std::swap(func, slot.next);
+        --m_nrSlotted;
+    }
+    return func;
+}
+
+std::function<void()> ThreadPool::stealSlotTask() {
+    if (m_nrSlotted.load() == 0) {
+        return nullptr;
+    }
+    for (auto& worker : m_workers) {
+        std::function<void()> func = takeSlotTask(worker.slot);
+        if (func) {
+            return func;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::workerFunction(WorkerList::iterator self) {
+    bool const elastic = (m_minThreads != m_maxThreads);
+    WorkerSlot& slot = self->slot;
+    s_pCurrentSlot = &slot;
+    // Busy polling is done once each time the worker becomes idle; if it finds nothing, the worker sleeps
+    bool polled = false;
+    std::unique_lock<std::mutex> lck(m_mutex);
+    --m_nrIdle;
     while (true) {
+        std::function<void()> func;
         if (!m_workItems.empty()) {
-            std::function<void()> func = std::move(m_workItems.front());
+            func = std::move(m_workItems.front().func);
             m_workItems.pop();
-            lck.unlock();
-            func();
-            lck.lock();
+            m_nrWorkItems.store(m_workItems.size(), std::memory_order_relaxed);
+            polled = false;
+            if (elastic) {
+                growIfNeeded(std::chrono::steady_clock::now());
+            }
         } else if (m_closing) {
             return;
         } else {
-            m_cv.wait(lck);
+            // The worker counts as idle before it looks at the slots, see enqueue(). A polling worker counts as idle
+            // too, so that the pool does not grow while it can take the next task.
+            ++m_nrIdle;
+            func = stealSlotTask();
+            if (func) {
+                polled = false;
+            } else if (!polled && (m_spinTime != std::chrono::steady_clock::duration::zero() || m_yieldTime != std::chrono::steady_clock::duration::zero())) {
+                std::chrono::steady_clock::duration spinTime = m_spinTime;
+                std::chrono::steady_clock::duration yieldTime = m_yieldTime;
+                lck.unlock();
+                pollForWork(spinTime, yieldTime);
+                lck.lock();
+                polled = true;
+            } else if (!elastic) {
+                m_cv.wait(lck);
+            } else {
+                bool timedOut = (m_cv.wait_for(lck, m_idleTimeout) == std::cv_status::timeout);
+                if (timedOut && m_workItems.empty() && !m_closing && m_workers.size() > m_minThreads) {
+                    // An idle worker's own slot is empty
+                    --m_nrIdle;
+                    m_retiredWorkers.push_back(std::move(self->thread));
+                    m_workers.erase(self);
+                    m_nrWorkers.store(m_workers.size(), std::memory_order_relaxed);
+                    return;
+                }
+            }
+            --m_nrIdle;
+            if (!func) {
+                continue;
+            }
+        }
+        lck.unlock();
+        func();
+        runSlot(slot);
+        lck.lock();
+        // Fairness limit reached; the slot task waits its turn behind the queued ones
+        std::function<void()> next = takeSlotTask(slot);
+        if (next) {
+            pushWorkItem(std::move(next));
         }
     }
 }
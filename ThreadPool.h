@@ -2,27 +2,150 @@
 
 #include "Executor.h"
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <list>
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <vector>
 
-/** @brief Simple thread pool, with a fixed number of threads.
+/** @brief Simple thread pool.
+ *
+ * The pool keeps between minThreads and maxThreads worker threads. A new worker is started when no worker is idle
+ * and the oldest queued task has been waiting for more than maxQueueDelay; a worker that stays idle for more than
+ * idleTimeout retires, as long as at least minThreads workers remain. The scaling decision is taken when a task is
+ * enqueued or dequeued, which costs a comparison on the paths that already take the pool lock. Since the workers may all
+ * be busy or blocked while no other task is enqueued, an elastic pool also has a monitor thread, that wakes up when
+ * the oldest queued task reaches maxQueueDelay, and only while tasks are queued and the pool may grow.
+ *
+ * A task enqueued by a task running on one of the workers (typically, a continuation of a future completed by that task)
+ * is not put in the shared queue, but in a "next task" slot of that worker, to be run as soon as the current task ends,
+ * on the same thread, with the data it uses still in the cache, and without taking the pool lock. Only the newest such
+ * task is kept in the slot; the previous one is moved to the shared queue, where other workers can take it. After
+ * maxConsecutiveSlotRuns tasks taken from the slot, the worker moves the task in the slot to the back of the shared queue,
+ * so that a chain of continuations cannot starve the other queued tasks. A task waiting in a slot is not tied to its
+ * worker: the slot is skipped when a worker is idle or when the pool has fewer than maxThreads workers (the task then
+ * goes to the shared queue, where the monitor starts a worker for it after maxQueueDelay if needed), and a worker that
+ * becomes idle takes the tasks left in the slots of the busy workers. So a task may block waiting for a task that it
+ * has enqueued itself, as long as another worker is running or can be started; with maxThreads workers all blocked
+ * this way, the pool deadlocks.
+ *
+ * Optionally (see setBusyPolling()), an idle worker first spins, then yields the CPU, watching the queue, before it sleeps
+ * on the condition variable; a task enqueued meanwhile starts without the latency of waking a thread up, at the cost of
+ * burning a core.
  * */
 class ThreadPool : public Executor
 {
 public:
+    /** @brief Creates a pool with a fixed number of threads.
+     * */
     explicit ThreadPool(size_t nrThreads);
+
+    /** @brief Creates an elastic pool, that grows when tasks wait for too long in the queue and shrinks when workers stay idle.
+     *
+     * useWorkerSlots set to false makes every task go through the shared queue, for pools whose tasks are expected to
+     * block, where keeping a task behind the running one only delays it.
+     * */
+    ThreadPool(size_t minThreads, size_t maxThreads,
+        std::chrono::steady_clock::duration maxQueueDelay = std::chrono::milliseconds(1),
+        std::chrono::steady_clock::duration idleTimeout = std::chrono::seconds(10),
+        bool useWorkerSlots = true);
     ~ThreadPool() override;
     void enqueue(std::function<void()> func) override;
+    size_t concurrency() const override;
+
+    /** @brief Returns the number of currently running worker threads.
+     * */
+    size_t nrThreads() const;
+
+    /**
+     * @brief Makes idle workers look for tasks without sleeping, for a while, before they sleep. Zero durations (the
+     * default) disable busy polling.
+     * @param spinTime how long an idle worker spins on the queue
+     * @param yieldTime how long it then keeps checking the queue, yielding the CPU between the checks
+     */
+    void setBusyPolling(std::chrono::steady_clock::duration spinTime, std::chrono::steady_clock::duration yieldTime);
 
 private:
-    void workerFunction();
+    /** @brief The maximum number of tasks a worker takes in a row from its slot, before turning to the shared queue.
+     * */
+    static unsigned const maxConsecutiveSlotRuns = 16;
+
+    /** @brief The minimum period at which the monitor checks a queue that idle workers are expected to drain.
+     * */
+    static constexpr std::chrono::milliseconds minMonitorPeriod{1};
+
+    struct WorkItem {
+        std::function<void()> func;
+        std::chrono::steady_clock::time_point enqueueTime;
+    };
+    /** @brief The next task of a worker, enqueued by the task it is running.
+     * */
+    struct WorkerSlot {
+        ThreadPool* pPool = nullptr;
+        /** Only contended when an idle worker takes the task over */
+        std::mutex mutex;
+        std::function<void()> next;
+    };
+    struct Worker {
+        std::thread thread;
+        WorkerSlot slot;
+    };
+    using WorkerList = std::list<Worker>;
+
+    void workerFunction(WorkerList::iterator self);
+    /** @brief Grows the pool when the oldest queued task waits for too long, even though no task is enqueued or dequeued.
+     * */
+    void monitorFunction();
+    /** @brief Starts a new worker if the queue is stalled; must be called with m_mutex held.
+     * */
+    void growIfNeeded(std::chrono::steady_clock::time_point now);
+    void startWorker();
+    /** @brief Runs the tasks put in the slot, up to maxConsecutiveSlotRuns; called without holding m_mutex.
+     * */
+    void runSlot(WorkerSlot& slot);
+    /** @brief Removes the task from the slot, if any.
+     * */
+    std::function<void()> takeSlotTask(WorkerSlot& slot);
+    /** @brief Takes a task from the slot of another worker, if any; must be called with m_mutex held.
+     * */
+    std::function<void()> stealSlotTask();
+    void pushWorkItem(std::function<void()> func);
+    /** @brief Waits, without sleeping, until the queue is not empty or the busy polling time is over; called without holding m_mutex.
+     * */
+    void pollForWork(std::chrono::steady_clock::duration spinTime, std::chrono::steady_clock::duration yieldTime) const;
+
+    /** The slot of the worker running on the current thread, if any */
+    static thread_local WorkerSlot* s_pCurrentSlot;
+
+    size_t const m_minThreads;
+    size_t const m_maxThreads;
+    std::chrono::steady_clock::duration const m_maxQueueDelay;
+    std::chrono::steady_clock::duration const m_idleTimeout;
+    bool const m_useWorkerSlots;
 
-    std::mutex m_mutex;
+    mutable std::mutex m_mutex;
     std::condition_variable m_cv;
     bool m_closing = false;
-    std::queue<std::function<void()> > m_workItems;
-    std::vector<std::thread> m_workers;
+    /** The number of idle workers, and of the workers being started, readable without the lock, to decide whether to
+     * use the slot */
+    std::atomic<size_t> m_nrIdle{0};
+    /** The number of tasks in the slots; idle workers only look at the slots when it is not zero */
+    std::atomic<size_t> m_nrSlotted{0};
+    /** The size of m_workers, readable without the lock */
+    std::atomic<size_t> m_nrWorkers{0};
+    std::queue<WorkItem> m_workItems;
+    /** The size of m_workItems, readable without the lock, for the busy polling workers */
+    std::atomic<size_t> m_nrWorkItems{0};
+    std::chrono::steady_clock::duration m_spinTime = std::chrono::steady_clock::duration::zero();
+    std::chrono::steady_clock::duration m_yieldTime = std::chrono::steady_clock::duration::zero();
+    WorkerList m_workers;
+    std::vector<std::thread> m_retiredWorkers;
+    /** Only for elastic pools; it waits on m_monitorCv, with m_mutex */
+    std::thread m_monitor;
+    std::condition_variable m_monitorCv;
+    /** Whether the monitor waits for a task to be enqueued, rather than for a deadline */
+    bool m_monitorSleeping = false;
 };
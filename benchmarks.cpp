@@ -0,0 +1,1314 @@
+#include "AsyncCache.h"
+#include "AsyncFile.h"
+#include "AsyncSemaphore.h"
+#include "Channel.h"
+#include "Continuations.h"
+#include "LazyPipeline.h"
+#include "ParallelAlgorithms.h"
+#include "Socket.h"
+#include "SocketStream.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/* Micro-benchmarks for the Future mechanism. They are started from main(), by name.
+ * */
+
+namespace {
+    std::atomic<size_t> nrBufferCopies{0};
+
+    /** @brief A buffer that counts how many times it gets copied.
+     * */
+    class CountedBuffer {
+    public:
+        explicit CountedBuffer(size_t size)
+            :m_data(size)
+            {}
+        CountedBuffer(CountedBuffer const& other)
+            :m_data(other.m_data)
+        {
+            ++nrBufferCopies;
+        }
+        CountedBuffer(CountedBuffer&&) = default;
+        CountedBuffer& operator=(CountedBuffer const& other) {
+            m_data = other.m_data;
+            ++nrBufferCopies;
+            return *this;
+        }
+        CountedBuffer& operator=(CountedBuffer&&) = default;
+
+        std::vector<char> m_data;
+    };
+
+    size_t const bufferSize = 1 << 20;
+    int const nrChainSteps = 10;
+    int const nrChainIterations = 200;
+
+    template<typename Func>
+    void reportChain(char const* name, Func runOneChain)
+    {
+        nrBufferCopies = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0 ; i < nrChainIterations ; ++i) {
+            runOneChain();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << elapsed.count() / nrChainIterations << "us per chain, "
+            << double(nrBufferCopies) / nrChainIterations << " buffer copies per chain\n";
+    }
+}
+
+namespace {
+    /** @brief Runs nrTasks tasks on an elastic pool starting with one worker, each blocking on a nested task, and reports
+     * how long it takes for the pool to grow enough to run them all (or FAILED after a timeout).
+     * */
+    void reportNestedTasks(int nrTasks, std::chrono::steady_clock::duration maxQueueDelay)
+    {
+        ThreadPool pool(1, size_t(nrTasks) + 1, maxQueueDelay);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Future<int> > results;
+        for(int i = 0 ; i < nrTasks ; ++i) {
+            results.push_back(launchAsync<int>(pool, [&pool]() {
+                return launchAsync<int>(pool, []() {return 42;}).get();
+            }));
+        }
+        bool ok = true;
+        for(Future<int> const& result : results) {
+            while(!result.isReady() && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            ok = ok && result.isReady() && result.get() == 42;
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::chrono::duration<double, std::milli> delay = maxQueueDelay;
+        std::cout << nrTasks << " blocked tasks, maxQueueDelay " << delay.count() << "ms: " << (ok ? "ok" : "FAILED")
+            << " in " << elapsed.count() << "ms, " << pool.nrThreads() << " threads\n";
+        if(!ok) {
+            // The blocked tasks would keep the pool destructor from returning
+            std::cout.flush();
+            _exit(1);
+        }
+    }
+}
+
+/** @brief Checks that an elastic pool grows when all its workers block on queued tasks, with nothing else enqueued.
+ * */
+void benchmark_elastic_pool()
+{
+    reportNestedTasks(1, std::chrono::milliseconds(1));
+    reportNestedTasks(8, std::chrono::milliseconds(1));
+    reportNestedTasks(8, std::chrono::milliseconds(10));
+}
+
+/** @brief Passes a 1MB buffer through a chain of continuations, with and without other Future objects sharing the values.
+ * */
+void benchmark_move_chain()
+{
+    ThreadPool threadPool(4);
+    reportChain("buffer, single consumer", [&threadPool]() {
+        Future<CountedBuffer> f = completedFuture(CountedBuffer(bufferSize));
+        for(int step = 0 ; step < nrChainSteps ; ++step) {
+            f = addContinuation<CountedBuffer>(threadPool, [](CountedBuffer b) {++b.m_data[0]; return b;}, std::move(f));
+        }
+        f.wait();
+    });
+    reportChain("buffer, intermediate futures kept", [&threadPool]() {
+        std::vector<Future<CountedBuffer> > chain;
+        chain.push_back(completedFuture(CountedBuffer(bufferSize)));
+        for(int step = 0 ; step < nrChainSteps ; ++step) {
+            chain.push_back(addContinuation<CountedBuffer>(threadPool, [](CountedBuffer b) {++b.m_data[0]; return b;}, chain.back()));
+        }
+        chain.back().wait();
+    });
+    reportChain("unique_ptr to buffer", [&threadPool]() {
+        Future<std::unique_ptr<CountedBuffer> > f = completedFuture(std::make_unique<CountedBuffer>(bufferSize));
+        for(int step = 0 ; step < nrChainSteps ; ++step) {
+            f = addContinuation<std::unique_ptr<CountedBuffer> >(threadPool,
+                [](std::unique_ptr<CountedBuffer> p) {++p->m_data[0]; return p;}, std::move(f));
+        }
+        f.wait();
+    });
+}
+
+namespace {
+    template<typename Func>
+    void reportElementLoop(char const* name, size_t nrElements, int nrIterations, Func runOnce)
+    {
+        long long sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0 ; i < nrIterations ; ++i) {
+            sum = runOnce();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        long long expected = 3 * (long long)nrElements * (nrElements - 1) / 2 + (long long)nrElements;
+        std::cout << name << ": " << elapsed.count() / nrIterations / nrElements << "ns per element, "
+            << elapsed.count() / nrIterations / 1000 << "us per call" << (sum == expected ? "" : " (WRONG SUM)") << "\n";
+    }
+
+    /** @brief Computes out[i] = 3 * in[i] + 1 and sums out over ranges of nrElements, serially and with the parallel
+     * algorithms.
+     * */
+    void reportParallelLoops(ThreadPool& threadPool, size_t nrElements, int nrIterations)
+    {
+        std::vector<long long> in(nrElements);
+        for(size_t i = 0 ; i < nrElements ; ++i) {
+            in[i] = (long long)i;
+        }
+        std::vector<long long> out(nrElements);
+        std::cout << nrElements << " elements:\n";
+        reportElementLoop("  serial loop", nrElements, nrIterations, [&in,&out]() {
+            long long sum = 0;
+            for(size_t i = 0 ; i < in.size() ; ++i) {
+                out[i] = 3 * in[i] + 1;
+                sum += out[i];
+            }
+            return sum;
+        });
+        reportElementLoop("  parallelFor, then serial sum", nrElements, nrIterations, [&threadPool,&in,&out]() {
+            parallelFor(threadPool, 0, in.size(), [&in,&out](size_t i) {
+                out[i] = 3 * in[i] + 1;
+            }).wait();
+            long long sum = 0;
+            for(long long val : out) {
+                sum += val;
+            }
+            return sum;
+        });
+        reportElementLoop("  parallelTransform + parallelReduce", nrElements, nrIterations, [&threadPool,&in,&out]() {
+            parallelTransform(threadPool, in.begin(), in.end(), out.begin(), [](long long val) {
+                return 3 * val + 1;
+            }).wait();
+            return parallelReduce(threadPool, out.begin(), out.end(), 0LL, [](long long a, long long b) {
+                return a + b;
+            }).get();
+        });
+    }
+}
+
+/** @brief Compares a serial loop with parallelFor, parallelTransform and parallelReduce, on a large range (per element
+ * overhead) and on a small one (fixed cost per call).
+ * */
+void benchmark_parallel_for()
+{
+    ThreadPool threadPool(std::max(1u, std::thread::hardware_concurrency()));
+    reportParallelLoops(threadPool, 4000000, 10);
+    reportParallelLoops(threadPool, 1000, 2000);
+}
+
+/** @brief Runs a 10-stage chain of trivial transformations, as separate continuations and as a fused lazy pipeline.
+ * */
+void benchmark_lazy_chain()
+{
+    ThreadPool threadPool(4);
+    int const nrIterations = 20000;
+    auto addOne = [](int a) {return a + 1;};
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrIterations ; ++i) {
+        Future<int> f = completedFuture(i);
+        for(int step = 0 ; step < nrChainSteps ; ++step) {
+            f = addContinuation<int>(threadPool, addOne, std::move(f));
+        }
+        f.wait();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "10 continuations: " << elapsed.count() / nrIterations << "us per chain\n";
+
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrIterations ; ++i) {
+        Future<int> f = lazyPipeline<int>().then(addOne).then(addOne).then(addOne).then(addOne).then(addOne)
+            .then(addOne).then(addOne).then(addOne).then(addOne).then(addOne)
+            .attach(threadPool, completedFuture(i));
+        f.wait();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "10-stage lazy pipeline: " << elapsed.count() / nrIterations << "us per chain\n";
+
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrIterations ; ++i) {
+        addContinuation<int>(threadPool, addOne, completedFuture(i)).wait();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "single continuation: " << elapsed.count() / nrIterations << "us per chain\n";
+
+    std::atomic<long> sum{0};
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrIterations ; ++i) {
+        Future<void> f = lazyPipeline<int>().then(addOne).then(addOne).then(addOne).then(addOne).then(addOne)
+            .then(addOne).then(addOne).then(addOne).then(addOne).then([&sum](int a){sum += a;})
+            .attach(threadPool, completedFuture(i));
+        f.wait();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    // A stage after a void stage takes no argument
+    Future<int> f = lazyPipeline<int>().then([&sum](int a){sum += a;}).then([](){return 1;}).start(threadPool, 0);
+    long expected = long(nrIterations) * (nrIterations - 1) / 2 + 9L * nrIterations;
+    std::cout << "10-stage lazy pipeline, void last stage: " << elapsed.count() / nrIterations << "us per chain"
+        << (sum == expected && f.get() == 1 ? "" : " (WRONG SUM)") << "\n";
+}
+
+namespace {
+    /** @brief Receives exactly len bytes, waiting for each recv() to complete. Returns false on error or end of stream.
+     * */
+    bool recvAll(Socket& socket, char* data, size_t len)
+    {
+        size_t received = 0;
+        while(received < len) {
+            ssize_t ret = socket.recv(data + received, len - received).get();
+            if(ret <= 0) {
+                return false;
+            }
+            received += size_t(ret);
+        }
+        return true;
+    }
+
+    /** @brief Measures round trips of a small message, and one-way bulk transfer, between two connected sockets.
+     * */
+    void reportTransport(char const* name, Socket& client, Socket& server)
+    {
+        size_t const messageSize = 64;
+        int const nrRoundTrips = 20000;
+        size_t const chunkSize = 65536;
+        size_t const totalSize = size_t(256) << 20;
+
+        std::thread echo([&server, messageSize, nrRoundTrips]() {
+            std::vector<char> buf(messageSize);
+            for(int i = 0 ; i < nrRoundTrips ; ++i) {
+                if(!recvAll(server, buf.data(), messageSize) || !server.send(buf.data(), messageSize).get()) {
+                    return;
+                }
+            }
+        });
+        std::vector<char> message(messageSize, 'x');
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0 ; i < nrRoundTrips ; ++i) {
+            if(!client.send(message.data(), messageSize).get() || !recvAll(client, message.data(), messageSize)) {
+                std::cout << name << ": round trip failed\n";
+                break;
+            }
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        echo.join();
+
+        std::thread sink([&server, chunkSize, totalSize]() {
+            std::vector<char> buf(chunkSize);
+            size_t received = 0;
+            while(received < totalSize) {
+                ssize_t ret = server.recv(buf.data(), chunkSize).get();
+                if(ret <= 0) {
+                    return;
+                }
+                received += size_t(ret);
+            }
+        });
+        std::vector<char> chunk(chunkSize, 'y');
+        start = std::chrono::steady_clock::now();
+        for(size_t sent = 0 ; sent < totalSize ; sent += chunkSize) {
+            if(!client.send(chunk.data(), chunkSize).get()) {
+                std::cout << name << ": send failed\n";
+                break;
+            }
+        }
+        sink.join();
+        std::chrono::duration<double> transferTime = std::chrono::steady_clock::now() - start;
+
+        std::cout << name << ": " << elapsed.count() / nrRoundTrips << "us per round trip, "
+            << double(totalSize) / (1 << 20) / transferTime.count() << "MB/s\n";
+    }
+}
+
+/** @brief Compares TCP over loopback, UNIX-domain sockets and socket pairs, for latency and throughput.
+ * */
+void benchmark_local_ipc()
+{
+    int const port = 5099;
+    std::unique_ptr<TcpServerSocket> pTcpServer = createTcpServer(port);
+    if(pTcpServer != nullptr) {
+        Future<std::shared_ptr<Socket> > fAccepted = pTcpServer->accept();
+        std::unique_ptr<Socket> pClient = tcpConnect("127.0.0.1", port).getMove();
+        std::shared_ptr<Socket> pServer = fAccepted.get();
+        if(pClient != nullptr && pServer != nullptr) {
+            reportTransport("TCP loopback", *pClient, *pServer);
+        }
+    }
+
+    std::string path = "/tmp/extend-cont-bench-" + std::to_string(getpid()) + ".sock";
+    std::unique_ptr<UnixServerSocket> pUnixServer = createUnixServer(path.c_str());
+    if(pUnixServer != nullptr) {
+        Future<std::shared_ptr<Socket> > fAccepted = pUnixServer->accept();
+        std::unique_ptr<Socket> pClient = unixConnect(path.c_str()).getMove();
+        std::shared_ptr<Socket> pServer = fAccepted.get();
+        if(pClient != nullptr && pServer != nullptr) {
+            reportTransport("UNIX socket", *pClient, *pServer);
+        }
+    }
+
+    std::pair<std::unique_ptr<Socket>, std::unique_ptr<Socket> > pair = createSocketPair();
+    if(pair.first != nullptr) {
+        reportTransport("socket pair", *pair.first, *pair.second);
+    }
+}
+
+namespace {
+    void reportFileThroughput(char const* name, size_t nrBytes, std::chrono::steady_clock::time_point start, bool ok)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << nrBytes / elapsed.count() / 1e6 << "MB/s" << (ok ? "" : " (WRONG DATA)") << "\n";
+    }
+}
+
+/** @brief Writes a file with AsyncFile::pwrite(), reads it back with pread(), and sends it over a socket pair with
+ * Socket::sendFile(), checking the data at each step.
+ * */
+void benchmark_async_file()
+{
+    size_t const chunkSize = 1 << 20;
+    size_t const nrChunks = 64;
+    size_t const fileSize = chunkSize * nrChunks;
+    char path[] = "/tmp/extend-cont-XXXXXX";
+    int tmpFd = ::mkstemp(path);
+    if(tmpFd < 0) {
+        perror("mkstemp()");
+        return;
+    }
+    ::close(tmpFd);
+    std::unique_ptr<AsyncFile> pFile = openAsyncFile(path, O_RDWR | O_TRUNC);
+    ::unlink(path);
+    if(pFile == nullptr) {
+        return;
+    }
+    std::vector<char> data(fileSize);
+    for(size_t i = 0 ; i < fileSize ; ++i) {
+        data[i] = char(i * 7 + i / 4096);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Future<ssize_t> > writes;
+    for(size_t i = 0 ; i < nrChunks ; ++i) {
+        writes.push_back(pFile->pwrite(&data[i * chunkSize], chunkSize, off_t(i * chunkSize)));
+    }
+    bool ok = true;
+    for(Future<ssize_t> const& write : writes) {
+        ok = ok && write.get() == ssize_t(chunkSize);
+    }
+    reportFileThroughput("pwrite, 1MB chunks", fileSize, start, ok && pFile->size() == off_t(fileSize));
+
+    std::vector<char> readBack(fileSize);
+    start = std::chrono::steady_clock::now();
+    std::vector<Future<ssize_t> > reads;
+    for(size_t i = 0 ; i < nrChunks ; ++i) {
+        reads.push_back(pFile->pread(&readBack[i * chunkSize], chunkSize, off_t(i * chunkSize)));
+    }
+    ok = true;
+    for(Future<ssize_t> const& read : reads) {
+        ok = ok && read.get() == ssize_t(chunkSize);
+    }
+    reportFileThroughput("pread, 1MB chunks", fileSize, start, ok && readBack == data);
+
+    std::pair<std::unique_ptr<Socket>, std::unique_ptr<Socket> > pair = createSocketPair();
+    if(pair.first == nullptr) {
+        return;
+    }
+    std::fill(readBack.begin(), readBack.end(), 0);
+    start = std::chrono::steady_clock::now();
+    Future<ssize_t> sent = pair.first->sendFile(pFile->fd(), 0, fileSize);
+    ok = recvAll(*pair.second, readBack.data(), fileSize);
+    reportFileThroughput("sendFile over a socket pair", fileSize, start, ok && sent.get() == ssize_t(fileSize) && readBack == data);
+}
+
+namespace {
+    /** @brief Sends the integers 0..nrValues-1 as text over the socket, then closes the sending side.
+     * */
+    std::thread startIntWriter(std::unique_ptr<Socket> pSocket, int nrValues)
+    {
+        return std::thread([pSocket=std::move(pSocket), nrValues]() mutable {
+            std::string text;
+            for(int i = 0 ; i < nrValues ; ++i) {
+                text += std::to_string(i);
+                text += '\n';
+                if(text.size() >= 65536 || i == nrValues - 1) {
+                    if(!pSocket->send(text.data(), text.size()).get()) {
+                        return;
+                    }
+                    text.clear();
+                }
+            }
+            pSocket.reset();
+        });
+    }
+
+    template<typename Func>
+    void reportIntStream(char const* name, int nrValues, Func consume)
+    {
+        ThreadPool threadPool(4);
+        BufferPool pool;
+        std::pair<std::unique_ptr<Socket>, std::unique_ptr<Socket> > pair = createSocketPair();
+        if(pair.first == nullptr) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::thread writer = startIntWriter(std::move(pair.first), nrValues);
+        AsyncStream<int> ints = parseIntStream(threadPool, socketByteStream(threadPool, std::shared_ptr<Socket>(std::move(pair.second)), pool));
+        long long sum = consume(ints);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        writer.join();
+        long long expected = (long long)nrValues * (nrValues - 1) / 2;
+        std::cout << name << ": " << elapsed.count() / nrValues << "ns per value" << (sum == expected ? "" : " (WRONG SUM)") << "\n";
+    }
+}
+
+namespace {
+    /** @brief Checks that an empty pushBatch() leaves a waiting consumer waiting, and that pushes after close() are rejected.
+     * */
+    void checkAsyncStreamEdgeCases()
+    {
+        AsyncStream<int> ints;
+        Future<std::optional<int> > next = ints.next();
+        bool ok = ints.pushBatch({}).get() && !next.isReady();
+        ok = ok && ints.push(1).get() && next.get() == 1;
+        Future<std::vector<int> > batch = ints.nextBatch(16);
+        ok = ok && ints.pushBatch({}).get() && !batch.isReady();
+        ok = ok && ints.pushBatch({2, 3}).get() && batch.get() == std::vector<int>{2, 3};
+        ints.close();
+        ok = ok && !ints.push(4).get() && !ints.pushBatch({5}).get() && !ints.next().get();
+        std::cout << "AsyncStream edge cases: " << (ok ? "ok" : "FAILED") << "\n";
+    }
+}
+
+/** @brief Checks the edge cases of AsyncStream, then parses a million integers received over a socket pair, pulling them
+ * one at a time and in batches.
+ * */
+void benchmark_async_stream()
+{
+    checkAsyncStreamEdgeCases();
+    int const nrValues = 1000000;
+    reportIntStream("next()", nrValues, [](AsyncStream<int>& ints) {
+        long long sum = 0;
+        while(true) {
+            std::optional<int> val = ints.next().getMove();
+            if(!val) {
+                return sum;
+            }
+            sum += *val;
+        }
+    });
+    reportIntStream("nextBatch(4096)", nrValues, [](AsyncStream<int>& ints) {
+        long long sum = 0;
+        while(true) {
+            std::vector<int> vals = ints.nextBatch(4096).getMove();
+            if(vals.empty()) {
+                return sum;
+            }
+            for(int val : vals) {
+                sum += val;
+            }
+        }
+    });
+}
+
+namespace {
+    /** @brief Sends the values in [first, last) to the channel, batchSize values at a time (one by one if batchSize is 1).
+     * The loop continues synchronously as long as the channel has room.
+     * */
+    Future<size_t> produceValues(Executor& executor, Channel<size_t>& channel, size_t first, size_t last, size_t batchSize)
+    {
+        return executeAsyncLoop<size_t>(executor, [last](size_t i){return i < last;},
+            [&executor,&channel,last,batchSize](size_t i)->Future<size_t> {
+                while(i < last) {
+                    Future<bool> sent = completedFuture(true);
+                    if(batchSize == 1) {
+                        sent = channel.send(i);
+                        ++i;
+                    } else {
+                        std::vector<size_t> batch;
+                        for( ; i < last && batch.size() < batchSize ; ++i) {
+                            batch.push_back(i);
+                        }
+                        sent = channel.sendBatch(std::move(batch));
+                    }
+                    if(!sent.isReady()) {
+                        return addContinuation<size_t>(executor, [i](bool){return i;}, std::move(sent));
+                    }
+                }
+                return completedFuture(i);
+            },
+            first);
+    }
+
+    /** @brief Receives values from the channel, adding them to *pSum, until the channel is closed and empty.
+     * */
+    Future<bool> consumeValues(Executor& executor, Channel<size_t>& channel, size_t* pSum, size_t batchSize)
+    {
+        return executeAsyncLoop<bool>(executor, [](bool cont){return cont;},
+            [&executor,&channel,pSum,batchSize](bool)->Future<bool> {
+                while(true) {
+                    if(batchSize == 1) {
+                        auto add = [pSum](std::optional<size_t> val) {
+                            if(val) {
+                                *pSum += *val;
+                            }
+                            return val.has_value();
+                        };
+                        Future<std::optional<size_t> > received = channel.receive();
+                        if(!received.isReady()) {
+                            return addContinuation<bool>(executor, add, std::move(received));
+                        }
+                        if(!add(received.getMove())) {
+                            return completedFuture(false);
+                        }
+                    } else {
+                        auto add = [pSum](std::vector<size_t> vals) {
+                            for(size_t val : vals) {
+                                *pSum += val;
+                            }
+                            return !vals.empty();
+                        };
+                        Future<std::vector<size_t> > received = channel.receiveBatch(batchSize);
+                        if(!received.isReady()) {
+                            return addContinuation<bool>(executor, add, std::move(received));
+                        }
+                        if(!add(received.getMove())) {
+                            return completedFuture(false);
+                        }
+                    }
+                }
+            },
+            true);
+    }
+
+    void reportChannel(size_t nrProducers, size_t nrConsumers, size_t batchSize)
+    {
+        size_t const nrValues = 1000000;
+        ThreadPool threadPool(8);
+        Channel<size_t> channel(1024);
+        std::vector<size_t> sums(nrConsumers, 0);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Future<bool> > consumers;
+        for(size_t i = 0 ; i < nrConsumers ; ++i) {
+            consumers.push_back(consumeValues(threadPool, channel, &sums[i], batchSize));
+        }
+        std::vector<Future<size_t> > producers;
+        for(size_t i = 0 ; i < nrProducers ; ++i) {
+            producers.push_back(produceValues(threadPool, channel, nrValues * i / nrProducers, nrValues * (i+1) / nrProducers, batchSize));
+        }
+        for(Future<size_t> const& producer : producers) {
+            producer.wait();
+        }
+        channel.close();
+        size_t sum = 0;
+        for(size_t i = 0 ; i < nrConsumers ; ++i) {
+            consumers[i].wait();
+            sum += sums[i];
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << nrProducers << " producers, " << nrConsumers << " consumers, batch " << batchSize << ": "
+            << nrValues / elapsed.count() / 1e6 << "M values/s" << (sum == nrValues * (nrValues - 1) / 2 ? "" : " (WRONG SUM)") << "\n";
+    }
+}
+
+/** @brief Passes a million values through a Channel, at several numbers of producers and consumers, one by one and in batches.
+ * */
+void benchmark_channel()
+{
+    size_t const configs[][2] = {{1, 1}, {1, 4}, {4, 1}, {4, 4}, {8, 8}};
+    for(size_t batchSize : {size_t(1), size_t(64)}) {
+        for(auto const& config : configs) {
+            reportChannel(config[0], config[1], batchSize);
+        }
+    }
+}
+
+namespace {
+    /** @brief Runs nrChains concurrent chains of nrSteps continuations, each step holding a permit of the semaphore while
+     * it increments *pCounter. Returns the highest number of steps seen holding a permit at the same time.
+     * */
+    int runGuardedChains(ThreadPool& threadPool, AsyncSemaphore& semaphore, int nrChains, int nrSteps, std::atomic<long>* pCounter)
+    {
+        std::atomic<int> nrInside{0};
+        std::atomic<int> maxInside{0};
+        std::vector<Future<int> > chains;
+        for(int chain = 0 ; chain < nrChains ; ++chain) {
+            chains.push_back(executeAsyncLoop<int>(threadPool, [nrSteps](int step){return step < nrSteps;},
+                [&threadPool,&semaphore,&nrInside,&maxInside,pCounter](int step)->Future<int> {
+                    return addContinuation<int>(threadPool, [&nrInside,&maxInside,pCounter,step](AsyncSemaphore::Guard) {
+                        int inside = ++nrInside;
+                        int prevMax = maxInside.load();
+                        while(inside > prevMax && !maxInside.compare_exchange_weak(prevMax, inside)) {
+                        }
+                        ++*pCounter;
+                        --nrInside;
+                        return step + 1;
+                    }, semaphore.acquire());
+                },
+                0));
+        }
+        for(Future<int> const& chain : chains) {
+            chain.wait();
+        }
+        return maxInside;
+    }
+}
+
+/** @brief Measures the uncontended cost of AsyncMutex against std::mutex, and the throughput of many continuation chains
+ * contending for an AsyncMutex and an AsyncSemaphore.
+ * */
+void benchmark_async_mutex()
+{
+    ThreadPool threadPool(8);
+    int const nrLocks = 1000000;
+
+    std::mutex stdMutex;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrLocks ; ++i) {
+        std::unique_lock<std::mutex> lck(stdMutex);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "std::mutex uncontended: " << elapsed.count() / nrLocks << "ns per lock\n";
+
+    AsyncMutex asyncMutex(threadPool);
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrLocks ; ++i) {
+        std::optional<AsyncMutex::Guard> guard = asyncMutex.tryAcquire();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "AsyncMutex::tryAcquire() uncontended: " << elapsed.count() / nrLocks << "ns per lock\n";
+
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrLocks ; ++i) {
+        asyncMutex.acquire();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "AsyncMutex::acquire() uncontended: " << elapsed.count() / nrLocks << "ns per lock\n";
+
+    int const nrChains = 1000;
+    int const nrSteps = 100;
+    for(size_t nrPermits : {size_t(1), size_t(4)}) {
+        AsyncSemaphore semaphore(threadPool, nrPermits);
+        std::atomic<long> counter{0};
+        start = std::chrono::steady_clock::now();
+        int maxInside = runGuardedChains(threadPool, semaphore, nrChains, nrSteps, &counter);
+        elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << nrChains << " chains, " << nrPermits << " permits: " << elapsed.count() / (nrChains * nrSteps)
+            << "ns per step, at most " << maxInside << " inside" << (counter == long(nrChains) * nrSteps ? "" : " (WRONG COUNT)") << "\n";
+    }
+}
+
+namespace {
+    /** @brief Simulates an expensive backend call: completes after 10ms, without holding a thread meanwhile.
+     * */
+    Future<std::string> slowBackendCall(ThreadPool& threadPool, AlarmClock& alarmClock, int key, std::atomic<int>* pNrCalls)
+    {
+        ++*pNrCalls;
+        Future<void> delay = alarmClock.setTimer(std::chrono::system_clock::now() + std::chrono::milliseconds(10));
+        std::shared_ptr<PromiseFuturePair<std::string> > ret = std::make_shared<PromiseFuturePair<std::string> >();
+        delay.addCommonCallback([&threadPool,ret,key](FutureCompletionState, std::exception_ptr) {
+            threadPool.enqueue([ret,key]() {
+                ret->set("value of key " + std::to_string(key));
+            });
+        });
+        return Future<std::string>(ret);
+    }
+}
+
+/** @brief Sends a burst of concurrent requests, over a few distinct keys, to a slow backend, directly and through an AsyncCache.
+ * */
+void benchmark_async_cache()
+{
+    ThreadPool threadPool(8);
+    AlarmClock alarmClock;
+    int const nrRequests = 20000;
+    int const nrKeys = 100;
+
+    for(bool useCache : {false, true}) {
+        AsyncCache<int, std::string> cache(alarmClock, std::chrono::seconds(60), 1 << 20,
+            [](int const&, std::string const& val){return sizeof(int) + sizeof(std::string) + val.size();});
+        std::atomic<int> nrCalls{0};
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Future<size_t> > results;
+        for(int i = 0 ; i < nrRequests ; ++i) {
+            int key = i % nrKeys;
+            Future<std::string> value = useCache
+                ? cache.get(key, [&threadPool,&alarmClock,key,&nrCalls]() {return slowBackendCall(threadPool, alarmClock, key, &nrCalls);})
+                : slowBackendCall(threadPool, alarmClock, key, &nrCalls);
+            results.push_back(addContinuation<size_t>(threadPool, [](std::string val){return val.size();}, std::move(value)));
+        }
+        for(Future<size_t> const& result : results) {
+            result.wait();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << (useCache ? "with cache: " : "without cache: ") << elapsed.count() << "ms, " << nrCalls << " backend calls";
+        if(useCache) {
+            AsyncCache<int, std::string>::Statistics stats = cache.statistics();
+            std::cout << ", " << stats.misses << " misses, " << stats.coalesced << " coalesced, " << stats.hits << " hits";
+        }
+        std::cout << "\n";
+    }
+}
+
+namespace {
+    /** @brief Opens and immediately resets nrConnections connections to the port, on the loopback interface.
+     * Returns the longest time a connect() took.
+     * */
+    std::chrono::steady_clock::duration connectMany(int port, int nrConnections)
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(uint16_t(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        std::chrono::steady_clock::duration maxConnectTime(0);
+        for(int i = 0 ; i < nrConnections ; ++i) {
+            int sd = ::socket(AF_INET, SOCK_STREAM, 0);
+            auto start = std::chrono::steady_clock::now();
+            if(0 > ::connect(sd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+                perror("connect()");
+                ::close(sd);
+                continue;
+            }
+            maxConnectTime = std::max(maxConnectTime, std::chrono::steady_clock::now() - start);
+            // Closing with a reset leaves no TIME_WAIT behind, so that the ephemeral ports are not exhausted
+            struct linger lin;
+            lin.l_onoff = 1;
+            lin.l_linger = 0;
+            ::setsockopt(sd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+            ::close(sd);
+        }
+        return maxConnectTime;
+    }
+
+    void reportAcceptRate(char const* name, int backlog, size_t batchSize, int nrConnectionsPerClient)
+    {
+        int const port = 5098;
+        int const nrClients = 8;
+        std::unique_ptr<TcpServerSocket> pServer = createTcpServer(port, backlog);
+        if(pServer == nullptr) {
+            return;
+        }
+        std::vector<std::chrono::steady_clock::duration> maxConnectTimes(nrClients);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for(int i = 0 ; i < nrClients ; ++i) {
+            clients.emplace_back([&maxConnectTimes,i,port,nrConnectionsPerClient]() {
+                maxConnectTimes[i] = connectMany(port, nrConnectionsPerClient);
+            });
+        }
+        size_t nrAccepted = 0;
+        while(nrAccepted < size_t(nrClients) * nrConnectionsPerClient) {
+            if(batchSize == 1) {
+                if(pServer->accept().get() == nullptr) {
+                    break;
+                }
+                ++nrAccepted;
+            } else {
+                std::vector<std::shared_ptr<Socket> > sockets = pServer->acceptBatch(batchSize).getMove();
+                if(sockets.empty()) {
+                    break;
+                }
+                nrAccepted += sockets.size();
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        for(std::thread& client : clients) {
+            client.join();
+        }
+        std::chrono::duration<double, std::milli> maxConnectTime = *std::max_element(maxConnectTimes.begin(), maxConnectTimes.end());
+        std::cout << name << ": " << nrAccepted / elapsed.count() << " connections/s, slowest connect "
+            << maxConnectTime.count() << "ms\n";
+    }
+}
+
+/** @brief Measures how many connections per second the server socket accepts, when several clients connect in a loop.
+ * */
+void benchmark_accept_rate()
+{
+    // With a short backlog, dropped SYNs are retransmitted after 1s, 3s, 7s...; fewer connections keep this case short
+    reportAcceptRate("accept(), backlog 10", 10, 1, 25);
+    reportAcceptRate("accept(), backlog SOMAXCONN", SOMAXCONN, 1, 2000);
+    reportAcceptRate("acceptBatch(64), backlog SOMAXCONN", SOMAXCONN, 64, 2000);
+}
+
+namespace {
+    /** @brief Starts nrCalls blocking calls of 20ms each, with the given launch function, and meanwhile measures how long a
+     * trivial task submitted to the compute pool waits before running.
+     * */
+    template<typename LaunchFunc>
+    void reportBlockingCalls(char const* name, ThreadPool& computePool, int nrCalls, LaunchFunc launch)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Future<int> > calls;
+        for(int i = 0 ; i < nrCalls ; ++i) {
+            calls.push_back(launch([i]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                return i;
+            }));
+        }
+        auto probeStart = std::chrono::steady_clock::now();
+        launchAsync<int>(computePool, [](){return 0;}).wait();
+        std::chrono::duration<double, std::milli> probeLatency = std::chrono::steady_clock::now() - probeStart;
+        for(Future<int> const& call : calls) {
+            call.wait();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << nrCalls << " blocking calls in " << elapsed.count() << "ms, compute task waited "
+            << probeLatency.count() << "ms\n";
+    }
+
+    /** @brief Starts nrCalls blocking calls that each wait for a nested blocking call, and a void blocking call, and
+     * checks that they all complete.
+     * */
+    void reportNestedBlockingCalls(ThreadPool& computePool, int nrCalls)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Future<int> > calls;
+        for(int i = 0 ; i < nrCalls ; ++i) {
+            calls.push_back(launchBlocking<int>(computePool, [&computePool,i]() {
+                return launchBlocking<int>(computePool, [i]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                    return i;
+                }).get();
+            }));
+        }
+        std::atomic<int> nrVoidCalls{0};
+        launchBlocking<void>(computePool, [&nrVoidCalls]() {
+            ++nrVoidCalls;
+        }).wait();
+        long sum = 0;
+        for(Future<int> const& call : calls) {
+            sum += call.get();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "launchBlocking, nested: " << nrCalls << " blocking calls in " << elapsed.count() << "ms"
+            << (sum == long(nrCalls) * (nrCalls - 1) / 2 && nrVoidCalls == 1 ? "" : " (WRONG SUM)") << "\n";
+    }
+}
+
+/** @brief Runs blocking calls on a compute pool sized to the cores, then offloaded with launchBlocking(), and shows how
+ * long the compute pool stays unavailable; then checks that nested and void blocking calls complete.
+ * */
+void benchmark_blocking()
+{
+    ThreadPool computePool(std::max(1u, std::thread::hardware_concurrency()));
+    int const nrCalls = 64;
+    reportBlockingCalls("launchAsync", computePool, nrCalls, [&computePool](auto func) {
+        return launchAsync<int>(computePool, std::move(func));
+    });
+    reportBlockingCalls("launchBlocking", computePool, nrCalls, [&computePool](auto func) {
+        return launchBlocking<int>(computePool, std::move(func));
+    });
+    reportNestedBlockingCalls(computePool, nrCalls);
+}
+
+/** @brief Measures the cost of producing and consuming an already completed future, with the value inline and in a
+ * PromiseFuturePair, and of forwarding an error through an Expected continuation.
+ * */
+void benchmark_ready_future()
+{
+    int const nrFutures = 1000000;
+    // Keeps the compiler from computing the whole loop at compile time
+    volatile int offset = 0;
+    long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrFutures ; ++i) {
+        sum += completedFuture(i + offset).get();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "completedFuture(), inline: " << elapsed.count() / nrFutures << "ns per future\n";
+
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrFutures ; ++i) {
+        std::shared_ptr<PromiseFuturePair<int> > pf = std::make_shared<PromiseFuturePair<int> >();
+        pf->set(i + offset);
+        sum += Future<int>(pf).get();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "completed PromiseFuturePair: " << elapsed.count() / nrFutures << "ns per future\n";
+
+    ThreadPool threadPool(1);
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrFutures ; ++i) {
+        Future<Expected<int,int> > f = addExpectedContinuation<int>(threadPool, [](int a){return a + 1;},
+            completedFuture(Expected<int,int>(makeUnexpected(i + offset))));
+        sum += f.get().error();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "error forwarded from a completed future: " << elapsed.count() / nrFutures << "ns per future"
+        << (sum == 0 ? " " : "") << "\n";
+}
+
+namespace {
+    /** @brief Starts the demo server in a child process, with its output discarded. Returns the child pid, or -1 on failure.
+     * */
+    pid_t startDemoServer(bool busyPolling)
+    {
+        pid_t pid = ::fork();
+        if(pid < 0) {
+            perror("fork()");
+            return -1;
+        }
+        if(pid == 0) {
+            int devNull = ::open("/dev/null", O_WRONLY);
+            if(devNull >= 0) {
+                ::dup2(devNull, STDOUT_FILENO);
+            }
+            ::execl("/proc/self/exe", "extend-cont", busyPolling ? "busy-poll" : nullptr, nullptr);
+            _exit(127);
+        }
+        return pid;
+    }
+
+    /** @brief Connects to the demo server, retrying while it starts. Returns the socket descriptor, or -1.
+     * */
+    int connectToDemoServer()
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(5000);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        for(int attempt = 0 ; attempt < 100 ; ++attempt) {
+            int sd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if(0 == ::connect(sd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+                int noDelay = 1;
+                ::setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                return sd;
+            }
+            ::close(sd);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        perror("connect()");
+        return -1;
+    }
+
+    /** @brief Sends requests of the text protocol one at a time, and reports the percentiles of the round trip times.
+     * */
+    void reportRoundTrips(char const* name, int sd)
+    {
+        int const nrWarmupRequests = 1000;
+        int const nrRequests = 20000;
+        std::vector<double> roundTrips;
+        roundTrips.reserve(nrRequests);
+        char response[64];
+        for(int i = 0 ; i < nrWarmupRequests + nrRequests ; ++i) {
+            std::string request = std::to_string(i) + " 1\n";
+            auto start = std::chrono::steady_clock::now();
+            if(::send(sd, request.data(), request.size(), 0) != ssize_t(request.size())) {
+                perror("send()");
+                return;
+            }
+            size_t received = 0;
+            do {
+                ssize_t ret = ::recv(sd, response + received, sizeof(response) - received, 0);
+                if(ret <= 0) {
+                    perror("recv()");
+                    return;
+                }
+                received += size_t(ret);
+            } while(response[received - 1] != '\n');
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            if(i >= nrWarmupRequests) {
+                roundTrips.push_back(elapsed.count());
+            }
+        }
+        std::sort(roundTrips.begin(), roundTrips.end());
+        std::cout << name << ": p50 " << roundTrips[roundTrips.size() / 2] << "us, p99 " << roundTrips[roundTrips.size() * 99 / 100]
+            << "us, p99.9 " << roundTrips[roundTrips.size() * 999 / 1000] << "us\n";
+    }
+}
+
+/** @brief Measures the round trip times of sequential requests to the demo server (on port 5000, which must be free),
+ * in the default mode and in the busy polling mode.
+ * */
+void benchmark_latency()
+{
+    for(bool busyPolling : {false, true}) {
+        pid_t pid = startDemoServer(busyPolling);
+        if(pid < 0) {
+            return;
+        }
+        int sd = connectToDemoServer();
+        if(sd >= 0) {
+            reportRoundTrips(busyPolling ? "busy polling" : "default", sd);
+            ::close(sd);
+        }
+        ::kill(pid, SIGTERM);
+        ::waitpid(pid, nullptr, 0);
+    }
+}
+
+namespace {
+    /** @brief Sends the whole buffer on a blocking socket. Returns false on error.
+     * */
+    bool sendAllBlocking(int sd, char const* data, size_t size)
+    {
+        while(size != 0) {
+            ssize_t ret = ::send(sd, data, size, MSG_NOSIGNAL);
+            if(ret <= 0) {
+                perror("send()");
+                return false;
+            }
+            data += ret;
+            size -= size_t(ret);
+        }
+        return true;
+    }
+
+    /** @brief Sends the pairs (i, 1) for i in [0, nrPairs) in the text protocol, from another thread, and sums the responses.
+     * */
+    long long sumPairsText(int sd, int nrPairs)
+    {
+        std::thread writer([sd,nrPairs]() {
+            std::string text;
+            for(int i = 0 ; i < nrPairs ; ++i) {
+                text += std::to_string(i);
+                text += " 1\n";
+                if(text.size() >= 65536 || i == nrPairs - 1) {
+                    if(!sendAllBlocking(sd, text.data(), text.size())) {
+                        return;
+                    }
+                    text.clear();
+                }
+            }
+        });
+        long long sum = 0;
+        long long current = 0;
+        int nrResponses = 0;
+        char buffer[65536];
+        while(nrResponses < nrPairs) {
+            ssize_t ret = ::recv(sd, buffer, sizeof(buffer), 0);
+            if(ret <= 0) {
+                perror("recv()");
+                break;
+            }
+            for(ssize_t i = 0 ; i < ret ; ++i) {
+                if(buffer[i] == '\n') {
+                    sum += current;
+                    current = 0;
+                    ++nrResponses;
+                } else {
+                    current = current * 10 + (buffer[i] - '0');
+                }
+            }
+        }
+        writer.join();
+        return sum;
+    }
+
+    /** @brief The same as sumPairsText(), with the binary protocol, in frames of pairsPerFrame pairs.
+     * */
+    long long sumPairsBinary(int sd, int nrPairs, int pairsPerFrame)
+    {
+        char magic = char(0xB5);
+        if(!sendAllBlocking(sd, &magic, 1)) {
+            return 0;
+        }
+        auto storeLittleEndian32 = [](unsigned char* p, uint32_t v) {
+            p[0] = uint8_t(v);
+            p[1] = uint8_t(v >> 8);
+            p[2] = uint8_t(v >> 16);
+            p[3] = uint8_t(v >> 24);
+        };
+        std::thread writer([sd,nrPairs,pairsPerFrame,storeLittleEndian32]() {
+            std::vector<unsigned char> frame;
+            for(int first = 0 ; first < nrPairs ; first += pairsPerFrame) {
+                int count = std::min(pairsPerFrame, nrPairs - first);
+                frame.resize(4 + size_t(count) * 8);
+                storeLittleEndian32(frame.data(), uint32_t(count) * 8);
+                for(int i = 0 ; i < count ; ++i) {
+                    storeLittleEndian32(&frame[4 + size_t(i) * 8], uint32_t(first + i));
+                    storeLittleEndian32(&frame[8 + size_t(i) * 8], 1);
+                }
+                if(!sendAllBlocking(sd, reinterpret_cast<char const*>(frame.data()), frame.size())) {
+                    return;
+                }
+            }
+        });
+        // The response is a stream of 32-bit little-endian values, each frame preceded by its length, which is skipped
+        long long sum = 0;
+        int nrResponses = 0;
+        size_t frameRemaining = 0;
+        unsigned char value[4];
+        size_t valueSize = 0;
+        unsigned char buffer[65536];
+        while(nrResponses < nrPairs) {
+            ssize_t ret = ::recv(sd, buffer, sizeof(buffer), 0);
+            if(ret <= 0) {
+                perror("recv()");
+                break;
+            }
+            for(ssize_t i = 0 ; i < ret ; ++i) {
+                value[valueSize++] = buffer[i];
+                if(valueSize < 4) {
+                    continue;
+                }
+                valueSize = 0;
+                uint32_t v = uint32_t(value[0]) | (uint32_t(value[1]) << 8) | (uint32_t(value[2]) << 16) | (uint32_t(value[3]) << 24);
+                if(frameRemaining == 0) {
+                    frameRemaining = v;
+                } else {
+                    sum += int32_t(v);
+                    ++nrResponses;
+                    frameRemaining -= 4;
+                }
+            }
+        }
+        writer.join();
+        return sum;
+    }
+
+    template<typename Func>
+    void reportPairThroughput(char const* name, int nrPairs, Func sumPairs)
+    {
+        int sd = connectToDemoServer();
+        if(sd < 0) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        long long sum = sumPairs(sd, nrPairs);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        ::close(sd);
+        long long expected = (long long)nrPairs * (nrPairs + 1) / 2;
+        std::cout << name << ": " << nrPairs / elapsed.count() / 1e6 << "M pairs/s" << (sum == expected ? "" : " (WRONG SUM)") << "\n";
+    }
+}
+
+/** @brief Measures how many pairs per second the demo server (on port 5000, which must be free) sums, with the text
+ * protocol and with the binary protocol.
+ * */
+void benchmark_protocols()
+{
+    pid_t pid = startDemoServer(false);
+    if(pid < 0) {
+        return;
+    }
+    int const nrPairs = 200000;
+    reportPairThroughput("text", nrPairs, [](int sd, int n) {
+        return sumPairsText(sd, n);
+    });
+    for(int pairsPerFrame : {16, 4096}) {
+        std::string name = "binary, " + std::to_string(pairsPerFrame) + " pairs per frame";
+        reportPairThroughput(name.c_str(), nrPairs, [pairsPerFrame](int sd, int n) {
+            return sumPairsBinary(sd, n, pairsPerFrame);
+        });
+    }
+    ::kill(pid, SIGTERM);
+    ::waitpid(pid, nullptr, 0);
+}
+
+namespace {
+    int const graphWidth = 8;
+    int const graphDepth = 8;
+
+    /** @brief Runs the layered graph of benchmark_task_graph() with continuations: a node depending on a and b is an
+     * addAsyncContinuation() on a, starting an addContinuation() on b.
+     * */
+    Future<int> runGraphWithContinuations(Executor& executor, std::atomic<int>* pCounter)
+    {
+        Future<int> source = launchAsync<int>(executor, [pCounter](){++*pCounter; return 0;});
+        std::vector<Future<int> > layer(graphWidth, source);
+        for(int depth = 0 ; depth < graphDepth ; ++depth) {
+            std::vector<Future<int> > nextLayer;
+            for(int i = 0 ; i < graphWidth ; ++i) {
+                Future<int> fb = layer[(i + 1) % graphWidth];
+                nextLayer.push_back(addAsyncContinuation<int>(executor, [&executor,pCounter,fb](int a) {
+                    return addContinuation<int>(executor, [pCounter,a](int b){++*pCounter; return a + b;}, fb);
+                }, layer[i]));
+            }
+            layer = std::move(nextLayer);
+        }
+        Future<int> sink = layer[0];
+        for(int i = 1 ; i < graphWidth ; ++i) {
+            sink = addAsyncContinuation<int>(executor, [&executor,pCounter,fb=layer[i]](int a) {
+                return addContinuation<int>(executor, [a](int b){return a + b;}, fb);
+            }, sink);
+        }
+        return addContinuation<int>(executor, [pCounter](int a){++*pCounter; return a;}, sink);
+    }
+
+    /** @brief Adds the layered graph of benchmark_task_graph() to a TaskGraph.
+     * */
+    void buildLayeredGraph(TaskGraph& graph, std::atomic<int>* pCounter)
+    {
+        auto nodeFunc = [pCounter](){++*pCounter;};
+        TaskGraph::NodeId source = graph.addNode(nodeFunc);
+        std::vector<TaskGraph::NodeId> layer(graphWidth, source);
+        for(int depth = 0 ; depth < graphDepth ; ++depth) {
+            std::vector<TaskGraph::NodeId> nextLayer;
+            for(int i = 0 ; i < graphWidth ; ++i) {
+                TaskGraph::NodeId node = graph.addNode(nodeFunc);
+                graph.addDependency(layer[i], node);
+                if(layer[(i + 1) % graphWidth] != layer[i]) {
+                    graph.addDependency(layer[(i + 1) % graphWidth], node);
+                }
+                nextLayer.push_back(node);
+            }
+            layer = std::move(nextLayer);
+        }
+        TaskGraph::NodeId sink = graph.addNode(nodeFunc);
+        for(TaskGraph::NodeId node : layer) {
+            graph.addDependency(node, sink);
+        }
+    }
+
+    void reportGraphRuns(char const* name, int nrRuns, std::chrono::steady_clock::time_point start, int count)
+    {
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        int const expected = nrRuns * (graphWidth * graphDepth + 2);
+        std::cout << name << ": " << elapsed.count() / nrRuns << "us per run"
+            << (count == expected ? "" : " (WRONG COUNT)") << "\n";
+    }
+}
+
+/** @brief Runs a fork/join graph, 8 nodes wide and 8 deep, each node depending on two of the previous layer, with
+ * continuations and with a TaskGraph, built once or for each run.
+ * */
+void benchmark_task_graph()
+{
+    ThreadPool threadPool(4);
+    int const nrRuns = 2000;
+
+    std::atomic<int> counter{0};
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrRuns ; ++i) {
+        runGraphWithContinuations(threadPool, &counter).wait();
+    }
+    reportGraphRuns("continuations", nrRuns, start, counter);
+
+    counter = 0;
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrRuns ; ++i) {
+        TaskGraph graph;
+        buildLayeredGraph(graph, &counter);
+        graph.run(threadPool).wait();
+    }
+    reportGraphRuns("TaskGraph built for each run", nrRuns, start, counter);
+
+    counter = 0;
+    TaskGraph graph;
+    buildLayeredGraph(graph, &counter);
+    start = std::chrono::steady_clock::now();
+    for(int i = 0 ; i < nrRuns ; ++i) {
+        graph.run(threadPool).wait();
+    }
+    reportGraphRuns("TaskGraph reused", nrRuns, start, counter);
+}
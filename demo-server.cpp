@@ -1,48 +1,169 @@
+#include "BufferPool.h"
 #include "Continuations.h"
 #include "Socket.h"
 #include "FutureWaiter.h"
+#include "ReplaySocket.h"
+#include "Strand.h"
 
 #include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <string.h>
 
 #include <iostream>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /* A demo application for the "Future" mechanism.
  * It represents a server that reads pairs numbers, in text format, and responds with their sums.
+ *
+ * Alternatively, if the first byte sent by the client is binaryProtocolMagic, the connection uses a binary protocol:
+ * the client sends frames consisting of a 32-bit little-endian payload length, followed by pairs of 32-bit little-endian
+ * integers; for each frame, the server responds with a frame holding the sums of the pairs, in the same format. A frame
+ * payload larger than maxFramePayloadSize ends the connection, since the response is held until the frame ends.
+ * */
+
+namespace {
+    uint8_t const binaryProtocolMagic = 0xB5;
+    size_t const frameHeaderSize = 4;
+    /** Bounds the memory held for the response of one frame (half the payload size) */
+    uint32_t const maxFramePayloadSize = 1 << 20;
+
+    uint32_t loadLittleEndian32(char const* p) {
+        unsigned char const* q = reinterpret_cast<unsigned char const*>(p);
+        return uint32_t(q[0]) | (uint32_t(q[1]) << 8) | (uint32_t(q[2]) << 16) | (uint32_t(q[3]) << 24);
+    }
+
+    void storeLittleEndian32(char* p, uint32_t v) {
+        p[0] = char(v);
+        p[1] = char(v >> 8);
+        p[2] = char(v >> 16);
+        p[3] = char(v >> 24);
+    }
+
+    /**
+     * @brief Computes the sums of pairs of 32-bit little-endian integers
+     * @param in nrPairs pairs of integers; need not be aligned
+     * @param nrPairs the number of pairs
+     * @param out where the nrPairs sums are to be stored; need not be aligned
+     */
+    void sumInt32Pairs(char const* in, size_t nrPairs, char* out) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        // x86 is little-endian, so the integers can be loaded directly; 4 pairs are summed at a time
+        for( ; i + 4 <= nrPairs ; i += 4) {
+            __m128 lo = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(in + 8*i)));
+            __m128 hi = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(in + 8*i + 16)));
+            __m128i first = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0)));
+            __m128i second = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3,1,3,1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*i), _mm_add_epi32(first, second));
+        }
+#endif
+        for( ; i < nrPairs ; ++i) {
+            storeLittleEndian32(out + 4*i, loadLittleEndian32(in + 8*i) + loadLittleEndian32(in + 8*i + 4));
+        }
+    }
+}
+
+/** @brief Expected failures of reading from a client; they are propagated as Expected errors, not as exceptions.
  * */
+enum class StreamError {
+    endOfStream, parseError, ioError
+};
 
 class BufferedReader {
 private:
     enum class ReadIntState {
-        beforeFirstDigit, readingNumber, atEnd, error
+        beforeFirstDigit, readingNumber, atEnd, endOfStream, error
     };
     struct ReadIntData {
         int tmpVal = 0;
         ReadIntState state = ReadIntState::beforeFirstDigit;
     };
 public:
-    BufferedReader(Executor* pExecutor, Socket* pSocket)
+    /** @brief Creates a reader over a socket. Its receive buffer is a slab of the pool, used as a ring; the slab is held
+     * only while there is buffered data, so an idle connection holds no buffer.
+     * */
+    BufferedReader(Executor* pExecutor, Socket* pSocket, BufferPool* pPool)
         :m_pExecutor(pExecutor),
         m_pSocket(pSocket),
-        m_buf(new char[5]),
-        m_bufPos(m_buf.get()),
-        m_bufEndData(m_bufPos),
-        m_bufEndAlloc(m_buf.get()+5),
+        m_pPool(pPool),
+        m_mask(pPool->slabSize() - 1),
+        m_readPos(0),
+        m_writePos(0),
         m_eof(false)
         {}
 
+    /** @brief The buffered data, not consumed yet, up to the point where the ring wraps around (see contiguousAvailable())
+     * */
+    char const* data() const {
+        return m_buf.data() + (m_readPos & m_mask);
+    }
+    size_t available() const {
+        return m_writePos - m_readPos;
+    }
+    /** @brief The number of bytes available starting at data()
+     * */
+    size_t contiguousAvailable() const {
+        return std::min(available(), m_pPool->slabSize() - (m_readPos & m_mask));
+    }
+    /** @brief Copies the first n buffered bytes (n <= available()), without consuming them
+     * */
+    void peek(char* dest, size_t n) const {
+        for(size_t i = 0 ; i < n ; ++i) {
+            dest[i] = m_buf.data()[(m_readPos + i) & m_mask];
+        }
+    }
+    /** @brief Marks the first n buffered bytes as consumed
+     * */
+    void consume(size_t n) {
+        m_readPos += n;
+    }
+
+    /**
+     * @brief Reads from the socket until at least n bytes are buffered
+     * @param n the number of bytes needed; it must not exceed the buffer size (the slab size of the pool), since a full
+     * buffer would be read as the end of the stream
+     * @return the number of buffered bytes, or the error (endOfStream if the stream ended with no buffered data, parseError if it ended with fewer than n bytes)
+     */
+    Future<Expected<size_t,StreamError> > fillAtLeast(size_t n) {
+        assert(n <= m_pPool->slabSize());
+        if(available() >= n) {
+            return completedFuture(Expected<size_t,StreamError>(available()));
+        }
+        Future<bool> loopResult = executeAsyncLoop<bool>(*m_pExecutor,
+            [this,n](bool ok){return ok && !m_eof && available() < n;},
+            [this](bool)->Future<bool> {return readMore();},
+            true);
+        return addContinuation<Expected<size_t,StreamError> >(*m_pExecutor, [this,n](bool ok)->Expected<size_t,StreamError> {
+                if(!ok) {
+                    return makeUnexpected(StreamError::ioError);
+                } else if(available() >= n) {
+                    return available();
+                } else if(available() == 0) {
+                    return makeUnexpected(StreamError::endOfStream);
+                } else {
+                    return makeUnexpected(StreamError::parseError);
+                }
+            }, std::move(loopResult));
+    }
+
     /**
      * @brief Reads an integer
-     * @return the read number, or -1 on error
+     * @return the read number, or the error (endOfStream if the stream ended before the first digit)
      */
-    Future<int> readInt() {
+    Future<Expected<int,StreamError> > readInt() {
         std::shared_ptr<ReadIntData> pData = std::make_shared<ReadIntData>();
         Future<bool> loopResult = executeAsyncLoop<bool>(*m_pExecutor,
             [](bool cont){return cont;},
             [this,pData](bool)->Future<bool> {
-                while(m_bufPos < m_bufEndData) {
-                    char c = *m_bufPos;
+                while(m_readPos != m_writePos) {
+                    char c = m_buf.data()[m_readPos & m_mask];
                     if(c >= '0' && c <= '9') {
                         pData->state = ReadIntState::readingNumber;
                         pData->tmpVal = 10*pData->tmpVal + (c-'0');
@@ -55,11 +176,13 @@ public:
                         pData->state = ReadIntState::error;
                         return completedFuture<bool>(false);
                     }
-                    ++m_bufPos;
+                    ++m_readPos;
                 }
                 if(m_eof) {
                     if(pData->state == ReadIntState::readingNumber) {
                         pData->state = ReadIntState::atEnd;
+                    } else if(pData->state == ReadIntState::beforeFirstDigit) {
+                        pData->state = ReadIntState::endOfStream;
                     } else {
                         pData->state = ReadIntState::error;
                     }
@@ -68,11 +191,17 @@ public:
                 return readMore();
             },
             true);
-        return addContinuation<int>(*m_pExecutor, [this, pData](bool)->int {
-                if(pData->state == ReadIntState::atEnd) {
+        return addContinuation<Expected<int,StreamError> >(*m_pExecutor, [pData](bool)->Expected<int,StreamError> {
+                switch(pData->state) {
+                case ReadIntState::atEnd:
                     return pData->tmpVal;
-                } else {
-                    return -1;
+                case ReadIntState::endOfStream:
+                    return makeUnexpected(StreamError::endOfStream);
+                case ReadIntState::error:
+                    return makeUnexpected(StreamError::parseError);
+                default:
+                    // the loop stopped because readMore() failed
+                    return makeUnexpected(StreamError::ioError);
                 }
             }, loopResult);
     }
@@ -83,133 +212,293 @@ private:
      * @return A future that will be set to true on success or false on error
      */
     Future<bool> readMore() {
-        if(m_bufPos < m_bufEndData) {
-            ::memmove(m_buf.get(), m_bufPos, m_bufEndData-m_bufPos);
-            m_bufEndData = m_buf.get() + (m_bufEndData-m_bufPos);
+        Future<ssize_t> recvBytesFuture = completedFuture<ssize_t>(0);
+        if(available() == 0) {
+            // Give the slab back while waiting; the socket takes a new one when data arrives
+            m_buf.reset();
+            m_readPos = 0;
+            m_writePos = 0;
+            recvBytesFuture = m_pSocket->recv(*m_pPool, &m_buf);
         } else {
-            m_bufEndData = m_buf.get();
+            size_t writeIndex = m_writePos & m_mask;
+            size_t freeBytes = std::min(m_pPool->slabSize() - available(), m_pPool->slabSize() - writeIndex);
+            recvBytesFuture = m_pSocket->recv(m_buf.data() + writeIndex, freeBytes);
         }
-        m_bufPos = m_buf.get();
-        Future<ssize_t> recvBytesFuture = m_pSocket->recv(m_bufEndData, m_bufEndAlloc-m_bufEndData);
         return addContinuation<bool>(*m_pExecutor, [this](ssize_t recvBytes)->bool {
             if(recvBytes < 0) {
                 ::perror("recv()");
                 return false;
             }
-            m_bufEndData += recvBytes;
+            m_writePos += recvBytes;
             if(recvBytes == 0) {
                 m_eof = true;
             }
             return true;
-        }, recvBytesFuture);
+        }, std::move(recvBytesFuture));
     }
 
-    
-    
-
     Executor* m_pExecutor;
     Socket* m_pSocket;
-    std::unique_ptr<char[]> m_buf;
-    char* m_bufPos;
-    char* m_bufEndData;
-    char* m_bufEndAlloc;
+    BufferPool* m_pPool;
+    BufferSlice m_buf;
+    size_t const m_mask;
+    size_t m_readPos;  // position of the first unconsumed byte, not wrapped around
+    size_t m_writePos; // position past the last received byte, not wrapped around
     bool m_eof;
 };
 
+/** Handles the requests of one client. All its continuations run on a strand over the server executor,
+ * so the connection state (including the BufferedReader) is never accessed concurrently.
+ * */
 class ClientHandler {
 public:
-    ClientHandler(Executor* pExecutor, std::shared_ptr<Socket> pSocket)
-        :m_pExecutor(pExecutor),
+    ClientHandler(Executor* pExecutor, BufferPool* pPool, std::shared_ptr<Socket> pSocket)
+        :m_strand(*pExecutor),
+        m_pExecutor(&m_strand),
+        m_pPool(pPool),
         m_pSocket(std::move(pSocket)),
-        m_reader(m_pExecutor, m_pSocket.get())
+        m_reader(m_pExecutor, m_pSocket.get(), m_pPool)
         {}
 
-    Future<bool> executeOneRequest() {
-        Future<int> fa = m_reader.readInt();
-        Future<int> fb = addAsyncContinuation<int>(*m_pExecutor,
-            [this](int a)->Future<int> {
-                if(a > 0) {
-                    return m_reader.readInt();
-                } else {
-                    throw -1;
-                }
+    /**
+     * @brief Reads two numbers and sends back their sum
+     * @return true if the request was handled and the next one may be read, false if sending failed, or the error that ended the stream
+     */
+    Future<Expected<bool,StreamError> > executeOneRequest() {
+        Future<Expected<int,StreamError> > fa = m_reader.readInt();
+        Future<Expected<int,StreamError> > fb = addAsyncExpectedContinuation<int>(*m_pExecutor,
+            [this](int)->Future<Expected<int,StreamError> > {
+                return m_reader.readInt();
             }, fa);
-        Future<bool> result = addAsyncContinuation<bool>(*m_pExecutor,
-            [this,fa](int b) -> Future<bool> {
-                if(b > 0) {
-                    int sum = fa.get() + b;
-                    std::shared_ptr<std::string> pSumStr = std::make_shared<std::string>(std::to_string(sum) + "\n");
-                    return m_pSocket->send(pSumStr);
-                } else {
-                    throw -2;
-                }
+        Future<Expected<bool,StreamError> > result = addAsyncExpectedContinuation<bool>(*m_pExecutor,
+            [this,fa](int b) -> Future<Expected<bool,StreamError> > {
+                int sum = fa.get().value() + b;
+                // A response is a few bytes; it is carved out of a slab shared with other responses
+                char text[16];
+                char* end = std::to_chars(text, text + sizeof(text), sum).ptr;
+                *end++ = '\n';
+                BufferSlice slice = m_pPool->allocateSmall(size_t(end - text));
+                memcpy(slice.data(), text, slice.size());
+                return addContinuation<Expected<bool,StreamError> >(*m_pExecutor,
+                    [](bool sent)->Expected<bool,StreamError> {return sent;}, m_pSocket->send(std::move(slice)));
             }, fb);
         return result;
     }
 
+    /**
+     * @brief Reads one binary frame of pairs of numbers and sends back a frame with their sums
+     * @return the same as executeOneRequest()
+     *
+     * The pairs are summed directly from the receive buffer, as they arrive, into pooled slices; the slices are sent
+     * together, with a single gathered write, at the end of the frame.
+     */
+    Future<Expected<bool,StreamError> > executeOneBinaryRequest() {
+        Future<Expected<size_t,StreamError> > headerF = m_reader.fillAtLeast(frameHeaderSize);
+        return addAsyncExpectedContinuation<bool>(*m_pExecutor, [this](size_t) -> Future<Expected<bool,StreamError> > {
+            char header[frameHeaderSize];
+            m_reader.peek(header, frameHeaderSize);
+            m_reader.consume(frameHeaderSize);
+            uint32_t payloadSize = loadLittleEndian32(header);
+            if(payloadSize % 8 != 0 || payloadSize > maxFramePayloadSize) {
+                return completedFuture(Expected<bool,StreamError>(makeUnexpected(StreamError::parseError)));
+            }
+            std::shared_ptr<BinaryFrameData> pData = std::make_shared<BinaryFrameData>();
+            pData->remaining = payloadSize;
+            pData->current = m_pPool->allocate();
+            storeLittleEndian32(pData->current.data(), payloadSize/2);
+            pData->outPos = frameHeaderSize;
+            Future<Expected<bool,StreamError> > loopF = executeAsyncLoop<Expected<bool,StreamError> >(*m_pExecutor,
+                [](Expected<bool,StreamError> const& r){return r.hasValue() && r.value();},
+                [this,pData](Expected<bool,StreamError> const&) -> Future<Expected<bool,StreamError> > {
+                    size_t nrBytes = std::min<size_t>(pData->remaining, m_reader.contiguousAvailable()) / 8 * 8;
+                    if(nrBytes != 0) {
+                        appendSums(*pData, m_reader.data(), nrBytes/8);
+                    } else if(pData->remaining != 0 && m_reader.available() >= 8) {
+                        // the pair wraps around the end of the ring buffer
+                        char pair[8];
+                        m_reader.peek(pair, 8);
+                        appendSums(*pData, pair, 1);
+                        nrBytes = 8;
+                    }
+                    m_reader.consume(nrBytes);
+                    pData->remaining -= nrBytes;
+                    if(pData->remaining == 0) {
+                        return completedFuture(Expected<bool,StreamError>(false));
+                    }
+                    return addExpectedContinuation<bool>(*m_pExecutor, [](size_t){return true;}, m_reader.fillAtLeast(8));
+                },
+                true);
+            return addAsyncExpectedContinuation<bool>(*m_pExecutor, [this,pData](bool) -> Future<Expected<bool,StreamError> > {
+                pData->response.push_back(pData->current.subSlice(0, pData->outPos));
+                pData->current.reset();
+                return addContinuation<Expected<bool,StreamError> >(*m_pExecutor,
+                    [](bool sent)->Expected<bool,StreamError> {return sent;}, m_pSocket->send(std::move(pData->response)));
+            }, std::move(loopF));
+        }, std::move(headerF));
+    }
+
+    /**
+     * @brief Handles all the requests of the client, in text or binary mode, as selected by the first byte it sends
+     */
     Future<bool> run() {
-        Future<bool> loopF = executeAsyncLoop<bool>(*m_pExecutor,
-            [](bool b){return b;},
-            [this](bool b){return executeOneRequest();},
-            true);
-        Future<bool> finish = addContinuation<bool>(*m_pExecutor, [this](bool)->bool{m_pSocket = nullptr;return false;}, loopF);
-        return catchAsync<bool>(*m_pExecutor, [this](std::exception_ptr pEx) -> Future<bool> {
-            try {
-                m_pSocket = nullptr;
-                std::rethrow_exception(pEx);
-            } catch(int i) {
-                if(i == -1) {
-                    std::cout << "Normal ending\n";
-                    return completedFuture<bool>(false);
+        Future<Expected<size_t,StreamError> > firstByteF = m_reader.fillAtLeast(1);
+        Future<Expected<bool,StreamError> > loopF = addAsyncExpectedContinuation<bool>(*m_pExecutor,
+            [this](size_t) -> Future<Expected<bool,StreamError> > {
+                bool binary = (uint8_t(m_reader.data()[0]) == binaryProtocolMagic);
+                if(binary) {
+                    m_reader.consume(1);
                 }
-                throw;
+                return executeAsyncLoop<Expected<bool,StreamError> >(*m_pExecutor,
+                    [](Expected<bool,StreamError> const& r){return r.hasValue() && r.value();},
+                    [this,binary](Expected<bool,StreamError> const&){return binary ? executeOneBinaryRequest() : executeOneRequest();},
+                    true);
+            }, std::move(firstByteF));
+        return addContinuation<bool>(*m_pExecutor, [this](Expected<bool,StreamError> const& r)->bool {
+            m_pSocket = nullptr;
+            if(r.hasValue()) {
+                std::cout << "Send failed\n";
+            } else if(r.error() == StreamError::endOfStream) {
+                std::cout << "Normal ending\n";
+            } else {
+                std::cout << "Request error\n";
             }
+            return false;
         }, loopF);
     }
 
 private:
+    struct BinaryFrameData {
+        size_t remaining = 0;
+        std::vector<BufferSlice> response; // the filled slices
+        BufferSlice current;               // the slice being filled
+        size_t outPos = 0;                 // the position in current
+    };
+
+    /** @brief Appends the sums of nrPairs pairs of integers to the response, taking more slices from the pool as needed
+     * */
+    void appendSums(BinaryFrameData& data, char const* in, size_t nrPairs) {
+        while(nrPairs > 0) {
+            if(data.outPos + 4 > data.current.size()) {
+                data.response.push_back(data.current.subSlice(0, data.outPos));
+                data.current = m_pPool->allocate();
+                data.outPos = 0;
+            }
+            size_t n = std::min(nrPairs, (data.current.size() - data.outPos) / 4);
+            sumInt32Pairs(in, n, data.current.data() + data.outPos);
+            in += 8*n;
+            nrPairs -= n;
+            data.outPos += 4*n;
+        }
+    }
+
+    Strand m_strand;
     Executor* m_pExecutor;
+    BufferPool* m_pPool;
     std::shared_ptr<Socket> m_pSocket; // try to change to unique_ptr
     BufferedReader m_reader;
 };
 
 class Server {
 public:
-    Server()
-        :m_executor(1)
-        {}
+    /** @brief Creates the server; with busyPolling, its workers and connections poll instead of sleeping while idle, for
+     * a lower latency at the cost of CPU time.
+     * */
+    explicit Server(bool busyPolling)
+        :m_executor(1, std::max(1u, std::thread::hardware_concurrency())),
+        m_busyPolling(busyPolling)
+    {
+        if(m_busyPolling) {
+            m_executor.setBusyPolling(busyPollSpinTime, busyPollYieldTime);
+        }
+    }
     void run() {
         m_pServerSocket = createTcpServer(5000);
-        Future<bool> loopF = executeAsyncLoop(m_executor, [](bool){return true;},
+        if(m_busyPolling) {
+            m_pServerSocket->setBusyPolling(busyPollSpinTime);
+        }
+        Future<bool> loopF = executeAsyncLoop<bool>(m_executor, [](bool cont){return cont;},
             [this](bool) {
-                Future<std::shared_ptr<Socket> > socketF = startProcessOneClient();
-                return addContinuation<bool>(m_executor, [](std::shared_ptr<Socket> pS)->bool {return pS != nullptr;}, socketF);
+                return addContinuation<bool>(m_executor, [this](std::vector<std::shared_ptr<Socket> > sockets)->bool {
+                    for(std::shared_ptr<Socket>& pSocket : sockets) {
+                        startClient(std::move(pSocket));
+                    }
+                    return !sockets.empty();
+                }, m_pServerSocket->acceptBatch(acceptBatchSize));
             }, true);
         m_waiter.addToWaitList(loopF);
         m_waiter.waitForAll();
     }
 
 private:
-    Future<std::shared_ptr<Socket> > startProcessOneClient() {
-        Future<std::shared_ptr<Socket> > socketF = m_pServerSocket->accept();
-        Future<std::shared_ptr<ClientHandler> > clientHandlerF = addContinuation<std::shared_ptr<ClientHandler> >(m_executor, 
-            [this](std::shared_ptr<Socket> const& pSocket) -> std::shared_ptr<ClientHandler> {
-                return std::make_shared<ClientHandler>(&m_executor, pSocket);
-        }, socketF);
-        Future<bool> finishF = addAsyncContinuation<bool>(m_executor, [this](std::shared_ptr<ClientHandler> clientHandler)->Future<bool>{
-            return clientHandler->run();
-        }, clientHandlerF);
-        Future<bool> clientHolderF = addContinuation<bool>(m_executor, [clientHandlerF](bool val){return val;}, finishF);
-        m_waiter.addToWaitList(clientHolderF);
-        return socketF;
+    /** @brief The maximum number of connections taken from the backlog at once.
+     * */
+    static size_t const acceptBatchSize = 64;
+    /** @brief Longer than the usual time between a response and the next request of a client, so that the latter is
+     * usually caught while spinning.
+     * */
+    static constexpr std::chrono::microseconds busyPollSpinTime{200};
+    static constexpr std::chrono::microseconds busyPollYieldTime{2000};
+
+    void startClient(std::shared_ptr<Socket> pSocket) {
+        std::shared_ptr<ClientHandler> pClientHandler = std::make_shared<ClientHandler>(&m_executor, &m_bufferPool, std::move(pSocket));
+        // The continuation keeps the handler alive until it finishes
+        m_waiter.addToWaitList(addContinuation<bool>(m_executor, [pClientHandler](bool val){return val;}, pClientHandler->run()));
     }
 
+    BufferPool m_bufferPool;
     FutureWaiter m_waiter;
     ThreadPool m_executor;
-    std::unique_ptr<ServerSocket> m_pServerSocket;
+    bool const m_busyPolling;
+    std::unique_ptr<TcpServerSocket> m_pServerSocket;
 };
 
-void demo_server() {
-    Server server;
+void demo_server(bool busyPolling) {
+    Server server(busyPolling);
     server.run();
 }
+
+/**
+ * @brief Replays a capture of client traffic through many concurrent ClientHandlers, over ReplaySockets, and reports the
+ * throughput of parsing and handling the requests, without any networking
+ * @param capturePath a file holding the bytes sent by a client over one connection, in either protocol
+ * @param nrClients the number of concurrent connections, each replaying the whole capture
+ * @param maxChunkSize the maximum number of bytes returned by each recv()
+ * @param randomChunkSizes if true, each recv() returns between 1 and maxChunkSize bytes
+ */
+void demo_replay(char const* capturePath, size_t nrClients, size_t maxChunkSize, bool randomChunkSizes) {
+    std::shared_ptr<ReplayCapture> pCapture = mapReplayCapture(capturePath);
+    if(pCapture == nullptr) {
+        return;
+    }
+    ThreadPool executor(std::max(1u, std::thread::hardware_concurrency()));
+    BufferPool bufferPool;
+    FutureWaiter waiter;
+    std::vector<std::shared_ptr<ReplaySocket> > sockets;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0 ; i < nrClients ; ++i) {
+        std::shared_ptr<ReplaySocket> pSocket = std::make_shared<ReplaySocket>(pCapture, maxChunkSize, randomChunkSizes, uint32_t(i + 1));
+        sockets.push_back(pSocket);
+        std::shared_ptr<ClientHandler> pClientHandler = std::make_shared<ClientHandler>(&executor, &bufferPool, std::move(pSocket));
+        waiter.addToWaitList(addContinuation<bool>(executor, [pClientHandler](bool val){return val;}, pClientHandler->run()));
+    }
+    waiter.waitForAll();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t bytesReceived = 0;
+    size_t bytesSent = 0;
+    size_t nrRequests = 0;
+    bool sameResponses = true;
+    for(std::shared_ptr<ReplaySocket> const& pSocket : sockets) {
+        bytesReceived += pSocket->bytesReceived();
+        bytesSent += pSocket->bytesSent();
+        nrRequests += pSocket->nrSends();
+        sameResponses = sameResponses && pSocket->checksum() == sockets.front()->checksum();
+    }
+    std::cout << nrClients << " clients, " << (randomChunkSizes ? "random chunks up to " : "chunks of ") << maxChunkSize << " bytes: "
+        << nrRequests / elapsed.count() << " requests/s, " << bytesReceived / elapsed.count() / 1e6 << "MB/s parsed, "
+        << bytesSent / elapsed.count() / 1e6 << "MB/s sent\n";
+    if(!sockets.empty()) {
+        std::cout << "response checksum " << std::hex << sockets.front()->checksum() << std::dec
+            << (sameResponses ? "" : " (DIFFERS BETWEEN CLIENTS)") << "\n";
+    }
+}
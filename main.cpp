@@ -3,6 +3,8 @@
 #include "ThreadPool.h"
 
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
 
 namespace {
     /**
@@ -27,7 +29,7 @@ namespace {
     void testDirect()
     {
         AlarmClock alarmClock;
-        ThreadPool threadPool(32);
+        ThreadPool threadPool(1, 32);
         auto f1 = delayedResult(alarmClock, 2000, 40);
         auto f2 = addContinuation<int>(threadPool, [](int a)->int {return a + 2; }, f1);
         auto ret = f2.get();
@@ -37,7 +39,7 @@ namespace {
     void testUnpack()
     {
         AlarmClock alarmClock;
-        ThreadPool threadPool(32);
+        ThreadPool threadPool(1, 32);
         auto f1 = delayedResult(alarmClock, 2000, 40);
         auto f2 = addAsyncContinuation<int>(threadPool, [&alarmClock](int a)->Future<int> {return delayedResult(alarmClock, 2000, a + 2); }, f1);
         auto ret = f2.get();
@@ -47,7 +49,7 @@ namespace {
     void testAsyncLoop()
     {
         AlarmClock alarmClock;
-        ThreadPool threadPool(32);
+        ThreadPool threadPool(1, 32);
         auto f = executeAsyncLoop<int>(threadPool,
             [](int v)->bool {return v < 42;},
             [&alarmClock](int const& v)->Future<int> {return delayedResult(alarmClock, 1000, v + 7); },
@@ -57,10 +59,75 @@ namespace {
     }
 }
 
-void demo_server();
+void demo_server(bool busyPolling);
+void demo_replay(char const* capturePath, size_t nrClients, size_t maxChunkSize, bool randomChunkSizes);
+void benchmark_elastic_pool();
+void benchmark_move_chain();
+void benchmark_parallel_for();
+void benchmark_lazy_chain();
+void benchmark_local_ipc();
+void benchmark_async_file();
+void benchmark_async_stream();
+void benchmark_channel();
+void benchmark_async_mutex();
+void benchmark_async_cache();
+void benchmark_accept_rate();
+void benchmark_blocking();
+void benchmark_ready_future();
+void benchmark_latency();
+void benchmark_protocols();
+void benchmark_task_graph();
 
-int main()
+namespace {
+    struct BenchmarkEntry {
+        char const* name;
+        void (*func)();
+    };
+
+    BenchmarkEntry const benchmarks[] = {
+        {"bench-elastic-pool", &benchmark_elastic_pool},
+        {"bench-move-chain", &benchmark_move_chain},
+        {"bench-parallel-for", &benchmark_parallel_for},
+        {"bench-lazy-chain", &benchmark_lazy_chain},
+        {"bench-local-ipc", &benchmark_local_ipc},
+        {"bench-async-file", &benchmark_async_file},
+        {"bench-async-stream", &benchmark_async_stream},
+        {"bench-channel", &benchmark_channel},
+        {"bench-async-mutex", &benchmark_async_mutex},
+        {"bench-async-cache", &benchmark_async_cache},
+        {"bench-accept-rate", &benchmark_accept_rate},
+        {"bench-blocking", &benchmark_blocking},
+        {"bench-ready-future", &benchmark_ready_future},
+        {"bench-latency", &benchmark_latency},
+        {"bench-protocols", &benchmark_protocols},
+        {"bench-task-graph", &benchmark_task_graph},
+    };
+}
+
+int main(int argc, char** argv)
 {
     std::cout << "Hello World!\n";
-    demo_server();
+    if(argc > 2 && 0 == strcmp(argv[1], "replay")) {
+        // replay <capture file> [clients] [max chunk size] [random]
+        size_t nrClients = argc > 3 ? strtoul(argv[3], nullptr, 10) : 64;
+        size_t maxChunkSize = argc > 4 ? strtoul(argv[4], nullptr, 10) : 1460;
+        bool randomChunkSizes = argc > 5 && 0 == strcmp(argv[5], "random");
+        demo_replay(argv[2], nrClients, maxChunkSize, randomChunkSizes);
+        return 0;
+    }
+    if(argc > 1 && 0 == strcmp(argv[1], "busy-poll")) {
+        demo_server(true);
+        return 0;
+    }
+    if(argc > 1) {
+        for(BenchmarkEntry const& benchmark : benchmarks) {
+            if(0 == strcmp(argv[1], benchmark.name)) {
+                benchmark.func();
+                return 0;
+            }
+        }
+        std::cout << "Unknown benchmark " << argv[1] << "\n";
+        return 1;
+    }
+    demo_server(false);
 }